@@ -3,11 +3,16 @@
 #include "windows.h"
 
 #include <cstdio>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 #include "lang_helpers.hpp"
 #include "math.hpp"
 #include "vector/vector.hpp"
 #include "random.hpp"
+#include "arena.hpp"
+#include "parallel.hpp"
 
 typedef s32v2	iv2;
 typedef s32v3	iv3;
@@ -38,6 +43,7 @@ static GLFWwindow*	wnd;
 static bool			fullscreen;
 static Rect			_suggested_wnd_rect;
 static Rect			_restore_wnd_rect;
+static bool			reset_swap_interval; // glfwSwapInterval still has to be called with the context current
 
 static u32			frame_indx; // probably should only used for debug logic
 
@@ -99,7 +105,9 @@ static void toggle_fullscreen () {
 	}
 	fullscreen = !fullscreen;
 	
-	glfwSwapInterval(1); // seems like vsync needs to be set after switching to from the inital hidden window to a fullscreen one, or there will be no vsync
+	// seems like vsync needs to be set after switching to from the inital hidden window to a fullscreen one, or there will be no vsync
+	//  needs the context, so it is done by whichever thread has it current (the render thread once it runs)
+	reset_swap_interval = true;
 }
 static void init_show_window (bool fullscreen, Rect rect=_suggested_wnd_rect) {
 	::fullscreen = !fullscreen;
@@ -203,6 +211,39 @@ static bool shad_check_link_status (GLuint prog) {
 	return !error;
 }
 
+// attribute locations are fixed for all shaders (bound before linking), so a vertex format's vao works with any shader that uses its attributes
+enum attrib_loc_e : GLuint {
+	ATTRIB_POS				=0,
+	ATTRIB_UV				,
+	ATTRIB_COL				,
+	ATTRIB_MESH_OFFS		,
+	ATTRIB_COUNT
+};
+static cstr attrib_names[ATTRIB_COUNT] = { "attrib_pos", "attrib_uv", "attrib_col", "attrib_mesh_offs" };
+
+// per frame render counters
+struct Render_Stats {
+	u32	draw_calls;
+	u32	state_changes; // program, vao, texture and uniform changes that actually reached gl
+};
+static Render_Stats	render_stats; // only touched by the render thread
+
+// currently bound objects, to skip redundant binds
+static GLuint		bound_prog;
+static GLuint		bound_vao;
+
+static void bind_vao (GLuint vao) {
+	if (bound_vao == vao) return;
+	glBindVertexArray(vao);
+	bound_vao = vao;
+	++render_stats.state_changes;
+}
+static void draw_arrays (GLenum primitive, s32 first, u32 count, u32 instances=1) {
+	if (instances == 1)	glDrawArrays(primitive, first, count);
+	else				glDrawArraysInstanced(primitive, first, count, instances);
+	++render_stats.draw_calls;
+}
+
 struct Basic_Shader {
 	GLuint		prog;
 	
@@ -226,6 +267,10 @@ struct Basic_Shader {
 		shad_check_compile_status(frag);
 		glAttachShader(prog, frag);
 		
+		for (GLuint i=0; i<ATTRIB_COUNT; ++i) {
+			glBindAttribLocation(prog, i, attrib_names[i]); // names the shader does not use are ignored
+		}
+		
 		glLinkProgram(prog);
 		shad_check_link_status(prog);
 		
@@ -236,7 +281,10 @@ struct Basic_Shader {
 		glDeleteShader(frag);
 	}
 	void bind () {
+		if (bound_prog == prog) return;
 		glUseProgram(prog);
+		bound_prog = prog;
+		++render_stats.state_changes;
 	}
 	
 };
@@ -245,77 +293,226 @@ struct Unif_s32 {
 	GLint loc;
 	void set (s32 i) const {
 		glUniform1i(loc, i);
+		++render_stats.state_changes;
 	}
 };
 struct Unif_flt {
 	GLint loc;
 	void set (f32 f) const {
 		glUniform1f(loc, f);
+		++render_stats.state_changes;
 	}
 };
 struct Unif_fv2 {
 	GLint loc;
 	void set (fv2 v) const {
 		glUniform2f(loc, v.x,v.y);
+		++render_stats.state_changes;
 	}
 };
 struct Unif_fv3 {
 	GLint loc;
 	void set (fv3 cr v) const {
 		glUniform3fv(loc, 1, &v.x);
+		++render_stats.state_changes;
 	}
 };
 struct Unif_fm2 {
 	GLint loc;
 	void set (fm2 m) const {
 		glUniformMatrix2fv(loc, 1, GL_FALSE, &m.arr[0][0]);
+		++render_stats.state_changes;
 	}
 };
 struct Unif_fm4 {
 	GLint loc;
 	void set (fm4 m) const {
 		glUniformMatrix4fv(loc, 1, GL_FALSE, &m.arr[0][0]);
+		++render_stats.state_changes;
 	}
 };
 
-struct VBO_Pos_Col {
+// one big buffer that all per-frame vertex data gets streamed into, instead of reallocating a buffer for every draw
+//  split into a region per frame in flight, uploads are suballocated from the current frame's region and written with unsynchronized mapping
+//  a fence per region makes sure the gpu is done with a region before we write into it again
+//  (persistent mapping would need ARB_buffer_storage, we only rely on 3.3 core)
+struct Stream_Buffer {
+	static constexpr u32 FRAMES = 3;
+	
 	GLuint	vbo;
-	struct V {
-		v2	pos;
-		v4	col;
-	};
+	uptr	region_size;
+	u32		region; // region of the current frame
+	uptr	head; // offset of the free space in the current region
+	GLsync	fences[FRAMES];
 	
-	void init () {
+	u64		bytes_this_frame;
+	u64		bytes_last_frame;
+	u32		grow_count; // should stay 0 after the first few frames
+	
+	void init (uptr initial_region_size=256*1024) {
+		region_size = initial_region_size;
+		
 		glGenBuffers(1, &vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, region_size*FRAMES, NULL, GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
-	void upload (array<V> data) {
-		uptr data_size = data.len * sizeof(V);
+	
+	// copies data into the buffer and returns the index of its first vertex (when bound with offset 0 and this stride)
+	s32 upload (void const* data, uptr size, uptr stride) {
+		uptr offs = alloc(size, stride);
+		if (offs +size > (region +1) * region_size) {
+			grow(size +stride);
+			offs = alloc(size, stride);
+		}
+		head = offs +size -region*region_size;
 		
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, data_size, NULL, GL_STATIC_DRAW);
-		glBufferData(GL_ARRAY_BUFFER, data_size, data.arr, GL_STATIC_DRAW);
+		bytes_this_frame += size;
 		
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		if (size > 0) {
+			glBindBuffer(GL_ARRAY_BUFFER, vbo);
+			
+			void* ptr = glMapBufferRange(GL_ARRAY_BUFFER, offs, size, GL_MAP_WRITE_BIT|GL_MAP_UNSYNCHRONIZED_BIT|GL_MAP_INVALIDATE_RANGE_BIT);
+			dbg_assert(ptr);
+			memcpy(ptr, data, size);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		
+		return (s32)(offs / stride);
+	}
+	// makes sure that the next uploads of size bytes in total (including their alignment padding) fit into the region without growing
+	//  growing orphans the storage, so a frame that grew after its first upload would draw that upload from the new, uninitialized storage
+	void reserve (uptr size) {
+		if (head +size > region_size) grow(head +size);
 	}
-	void bind (Basic_Shader cr shad) {
+	
+	// fence the regions of this frame and move on to the next one, waiting for the gpu if it is still using it (normally it is long done)
+	void end_frame () {
+		if (fences[region]) glDeleteSync(fences[region]);
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		
+		region = (region +1) % FRAMES;
+		head = 0;
+		
+		if (fences[region]) {
+			while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull) == GL_TIMEOUT_EXPIRED);
+			glDeleteSync(fences[region]);
+			fences[region] = 0;
+		}
+		
+		bytes_last_frame = bytes_this_frame;
+		bytes_this_frame = 0;
+	}
+	
+private:
+	// absolute offset of the next upload, aligned to the vertex stride so that it can be expressed as a first vertex index
+	uptr alloc (uptr size, uptr stride) {
+		uptr offs = region*region_size +head;
+		return (offs +stride -1) / stride * stride;
+	}
+	// a frame did not fit into its region, reallocate bigger
+	//  buffer data orphans the old storage, draws that still use it are fine, so all regions are free after this
+	void grow (uptr min_size) {
+		while (region_size < min_size) region_size *= 2;
+		region_size *= 2;
 		
 		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, region_size*FRAMES, NULL, GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		
-		GLint	pos =	glGetAttribLocation(shad.prog, "attrib_pos");
-		GLint	col =	glGetAttribLocation(shad.prog, "attrib_col");
+		for (auto& f : fences) {
+			if (f) glDeleteSync(f);
+			f = 0;
+		}
+		head = 0;
 		
-		dbg_assert(pos >= 0);
-		dbg_assert(col >= 0);
+		++grow_count;
+	}
+};
+constexpr u32 Stream_Buffer::FRAMES;
+
+static Stream_Buffer	stream_buf;
+
+// packed vertex components
+struct rgba8 {
+	u8	r, g, b, a;
+};
+static rgba8 pack_rgba8 (v4 c) {
+	auto to_u8 = [] (f32 x) { return (u8)(clamp(x, 0.0f, 1.0f) * 255.0f +0.5f); };
+	return { to_u8(c.x), to_u8(c.y), to_u8(c.z), to_u8(c.w) };
+}
+struct unorm16x2 {
+	u16	x, y;
+};
+static unorm16x2 pack_unorm16x2 (v2 v) {
+	auto to_u16 = [] (f32 x) { return (u16)(clamp(x, 0.0f, 1.0f) * 65535.0f +0.5f); };
+	return { to_u16(v.x), to_u16(v.y) };
+}
+
+// vertex formats, set_attrib_pointers defines the layout for the vao of VBO<V>
+struct Vertex_Pos_Col { // 12 bytes
+	v2			pos;
+	rgba8		col;
+	
+	static void set_attrib_pointers () {
+		glEnableVertexAttribArray(ATTRIB_POS);
+		glVertexAttribPointer(ATTRIB_POS,	2, GL_FLOAT, GL_FALSE,			sizeof(Vertex_Pos_Col), (void*)offsetof(Vertex_Pos_Col,pos));
 		
-		glEnableVertexAttribArray(pos);
-		glVertexAttribPointer(pos,	2, GL_FLOAT, GL_FALSE, sizeof(V), (void*)offsetof(V,pos));
+		glEnableVertexAttribArray(ATTRIB_COL);
+		glVertexAttribPointer(ATTRIB_COL,	4, GL_UNSIGNED_BYTE, GL_TRUE,	sizeof(Vertex_Pos_Col), (void*)offsetof(Vertex_Pos_Col,col));
+	}
+};
+struct Vertex_Pos_Tex_Col { // 16 bytes
+	v2			pos;
+	unorm16x2	uv; // has to be in [0,1]
+	rgba8		col;
+	
+	static void set_attrib_pointers () {
+		glEnableVertexAttribArray(ATTRIB_POS);
+		glVertexAttribPointer(ATTRIB_POS,	2, GL_FLOAT, GL_FALSE,			sizeof(Vertex_Pos_Tex_Col), (void*)offsetof(Vertex_Pos_Tex_Col,pos));
+		
+		glEnableVertexAttribArray(ATTRIB_UV);
+		glVertexAttribPointer(ATTRIB_UV,	2, GL_UNSIGNED_SHORT, GL_TRUE,	sizeof(Vertex_Pos_Tex_Col), (void*)offsetof(Vertex_Pos_Tex_Col,uv));
+		
+		glEnableVertexAttribArray(ATTRIB_COL);
+		glVertexAttribPointer(ATTRIB_COL,	4, GL_UNSIGNED_BYTE, GL_TRUE,	sizeof(Vertex_Pos_Tex_Col), (void*)offsetof(Vertex_Pos_Tex_Col,col));
+	}
+};
+
+// vertecies of one format streamed through stream_buf, the vao captures the layout of the format
+template <typename VERT> struct VBO {
+	typedef VERT V;
+	
+	GLuint	vao;
+	
+	void init () {
+		glGenVertexArrays(1, &vao);
+		glBindVertexArray(vao);
 		
-		glEnableVertexAttribArray(col);
-		glVertexAttribPointer(col,	4, GL_FLOAT, GL_FALSE, sizeof(V), (void*)offsetof(V,col));
+		glBindBuffer(GL_ARRAY_BUFFER, stream_buf.vbo);
+		V::set_attrib_pointers();
 		
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		bound_vao = 0;
+	}
+	// returns the first vertex to draw with
+	s32 upload (array<V> cr data) {
+		return stream_buf.upload(data.arr, data.len * sizeof(V), sizeof(V));
+	}
+	// what upload(data) can take from the stream buffer at most, for Stream_Buffer::reserve
+	static uptr upload_size (array<V> cr data) {
+		return (data.len +1) * sizeof(V);
+	}
+	void bind () {
+		bind_vao(vao);
 	}
 	
 };
+typedef VBO<Vertex_Pos_Col>		VBO_Pos_Col;
+typedef VBO<Vertex_Pos_Tex_Col>	VBO_Pos_Tex_Col;
 struct Shader_Clip_Col : Basic_Shader {
 	Shader_Clip_Col (): Basic_Shader(
 // Vertex shader
@@ -352,9 +549,18 @@ GLSL_VERSION R"_SHAD(
 	in		vec4	attrib_col;
 	out		vec4	color;
 	uniform	mat4	world_to_clip;
+	uniform	vec2	world_radius;
+	uniform	int		wrap_axes; // which axes the instances are fake wrapping copies along (1: x  2: y  3: both)
 	
 	void main() {
-		gl_Position = world_to_clip * vec4(attrib_pos, 0.0, 1.0);
+		// instance 0 is the original, the others are shifted by one world size along the wrap axes (same as get_wrap_instance_offset)
+		ivec2 wrap;
+		wrap.x = (wrap_axes & 1) != 0 ? gl_InstanceID & 1 : 0;
+		wrap.y = (wrap_axes & 2) != 0 ? (gl_InstanceID >> (wrap_axes & 1)) & 1 : 0;
+		
+		vec2 fake_wrap_offs = vec2(wrap) * 2.0 * world_radius;
+		
+		gl_Position = world_to_clip * vec4(attrib_pos +fake_wrap_offs, 0.0, 1.0);
 		color = attrib_col;
 	}
 )_SHAD",
@@ -371,61 +577,351 @@ GLSL_VERSION R"_SHAD(
 	
 	// uniforms
 	Unif_fm4	world_to_clip;
+	Unif_fv2	world_radius;
+	Unif_s32	wrap_axes;
 	
 	void init () {
 		compile();
 		
 		world_to_clip.loc =		glGetUniformLocation(prog, "world_to_clip");
+		world_radius.loc =		glGetUniformLocation(prog, "world_radius");
+		wrap_axes.loc =			glGetUniformLocation(prog, "wrap_axes");
 		
 		dbg_assert(world_to_clip.loc >= 0);
+		dbg_assert(world_radius.loc >= 0);
+		dbg_assert(wrap_axes.loc >= 0);
 		
 	}
 };
 
-struct VBO_Pos_Tex_Col {
-	GLuint	vbo;
+// per instance data for Shader_Asteroid, the meshes themselves stay on the gpu
+struct VBO_Asteroid_Instance {
+	GLuint	vao; // layout of this vertex format in stream_buf
 	struct V {
-		v2	pos;
-		v2	uv;
-		v4	col;
+		v2	pos; // world
+		s32	mesh_offs; // first vertex in the mesh buffer texture
 	};
 	
 	void init () {
-		glGenBuffers(1, &vbo);
-	}
-	void upload (array<V> cr data) {
-		uptr data_size = data.len * sizeof(V);
+		glGenVertexArrays(1, &vao);
+		glBindVertexArray(vao);
 		
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, data_size, NULL, GL_STATIC_DRAW);
-		glBufferData(GL_ARRAY_BUFFER, data_size, data.arr, GL_STATIC_DRAW);
+		glEnableVertexAttribArray(ATTRIB_POS);
+		glVertexAttribDivisor(ATTRIB_POS, 1);
+		
+		glEnableVertexAttribArray(ATTRIB_MESH_OFFS);
+		glVertexAttribDivisor(ATTRIB_MESH_OFFS, 1);
 		
+		set_pointers(0);
+		
+		glBindVertexArray(0);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		bound_vao = 0;
+	}
+	// returns the first instance to bind with
+	s32 upload (array<V> cr data) {
+		return stream_buf.upload(data.arr, data.len * sizeof(V), sizeof(V));
+	}
+	static uptr upload_size (array<V> cr data) {
+		return (data.len +1) * sizeof(V);
+	}
+	// no base instance in 3.3, so the first instance is applied as an attribute offset, which is the only state that changes per bind
+	void bind (s32 first) {
+		bind_vao(vao);
+		set_pointers(first);
+		++render_stats.state_changes;
 	}
-	void bind (Basic_Shader cr shad) {
+	
+private:
+	void set_pointers (s32 first) {
+		uptr offs = (uptr)first * sizeof(V);
 		
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, stream_buf.vbo);
+		
+		glVertexAttribPointer(ATTRIB_POS,				2, GL_FLOAT, GL_FALSE,	sizeof(V), (void*)(offs +offsetof(V,pos)));
+		glVertexAttribIPointer(ATTRIB_MESH_OFFS,		1, GL_INT,				sizeof(V), (void*)(offs +offsetof(V,mesh_offs)));
+	}
+};
+struct Shader_Asteroid : Basic_Shader {
+	Shader_Asteroid (): Basic_Shader(
+// Vertex shader
+GLSL_VERSION R"_SHAD(
+	in		vec2	attrib_pos; // world, per instance
+	in		int		attrib_mesh_offs; // per instance
+	out		vec4	color;
+	uniform	mat4			world_to_clip;
+	uniform	samplerBuffer	meshes;
+	
+	void main() {
+		// drawn as GL_LINE_LOOP, so every mesh vertex is processed once and the loop closes itself (or as GL_POINTS from the center vertex of the mesh slot)
+		vec2 pos = attrib_pos +texelFetch(meshes, attrib_mesh_offs +gl_VertexID).xy;
+		
+		gl_Position = world_to_clip * vec4(pos, 0.0, 1.0);
+		color = vec4(1);
+	}
+)_SHAD",
+// Fragment shader
+GLSL_VERSION R"_SHAD(
+	in		vec4	color;
+	out		vec4	frag_col;
+	
+	void main() {
+		frag_col = color;
+	}
+)_SHAD"
+	) {}
+	
+	// uniforms
+	Unif_fm4	world_to_clip;
+	
+	static constexpr s32 MESHES_TEX_UNIT = 1;
+	
+	void init () {
+		compile();
 		
-		GLint	pos =	glGetAttribLocation(shad.prog, "attrib_pos");
-		GLint	uv =	glGetAttribLocation(shad.prog, "attrib_uv");
-		GLint	col =	glGetAttribLocation(shad.prog, "attrib_col");
+		world_to_clip.loc =		glGetUniformLocation(prog, "world_to_clip");
 		
-		dbg_assert(pos >= 0);
-		dbg_assert(uv >= 0);
-		dbg_assert(col >= 0);
+		dbg_assert(world_to_clip.loc >= 0);
 		
-		glEnableVertexAttribArray(pos);
-		glVertexAttribPointer(pos,	2, GL_FLOAT, GL_FALSE, sizeof(V), (void*)offsetof(V,pos));
+		auto meshes = glGetUniformLocation(prog, "meshes");
+		dbg_assert(meshes != -1);
+		bind();
+		glUniform1i(meshes, MESHES_TEX_UNIT);
+	}
+};
+constexpr s32 Shader_Asteroid::MESHES_TEX_UNIT;
+
+// array for data that gets recorded again every frame, clear() keeps the memory
+//  grows by doubling, so once the arrays reached the size of a typical frame recording one does not allocate anymore (dynarr reallocs on every push and frees on realloc(0))
+//  has to start out zeroed (static)
+template <typename T>
+struct Frame_Array : array<T> {
+	u32		capacity;
+	
+	void reserve (u32 min_capacity) {
+		if (min_capacity <= capacity) return;
+		capacity = MAX(MAX(min_capacity, capacity*2), (u32)64);
+		this->arr = (T*)::realloc(this->arr, capacity*sizeof(T));
+	}
+	u32 pushn (u32 count) {
+		u32 old_len = this->len;
+		reserve(this->len +count);
+		this->len += count;
+		return old_len;
+	}
+	void push (T cr val) {
+		u32 i = pushn(1); // before reading arr, pushn can move it
+		this->arr[i] = val;
+	}
+	void clear () {
+		this->len = 0;
+	}
+};
+
+// render commands, the data they draw lives in the arrays of their Render_Frame
+enum render_cmd_e : u32 {
+	RCMD_UPLOAD_MESH		=0, // arg: asteroid mesh slot, first/count: mesh_verts
+	RCMD_DRAW_WORLD			, // arg: gl primitive | wrap axes << 8, first/count: world_verts, with shad_world_col (instanced if there are wrap axes)
+	RCMD_DRAW_ASTEROIDS		, // arg: vertecies per instance, first/count: asteroid_instances, one instanced line loop (points if arg is 1)
+	RCMD_UPLOAD_GLYPH		, // arg: cell of the font atlas | width << 16, first/count: atlas_pixels, a rect of width x count/width at the origin of the cell
+	RCMD_UPLOAD_TEXT		, // arg: first vertex in the resident text buffer, first/count: text_verts
+	RCMD_DRAW_TEXT			, // first/count: text_firsts and text_counts, lines in the resident text buffer drawn with shad_tex (or shad_tex_sdf) and the font texture
+};
+struct Render_Cmd {
+	render_cmd_e	type;
+	u32				arg;
+	u32				first;
+	u32				count;
+};
+
+// everything the render thread needs to draw one frame, recorded by the simulation
+//  all data is copied in, so the simulation can go on changing its state while the frame is drawn
+//  has to start out zeroed (static)
+struct Render_Frame {
+	iv2			viewport;
+	v4			clear_col;
+	m4			world_to_clip;
+	bool		reset_swap_interval;
+	u32			mesh_slots_used; // the mesh buffer has to be at least this big before the uploads
+	u32			text_verts_used; // same for the resident text buffer
+	
+	Frame_Array<Render_Cmd>					cmds; // executed in order after the clear
+	
+	Frame_Array<v2>							mesh_verts;
+	Frame_Array<Vertex_Pos_Col>				world_verts;
+	Frame_Array<VBO_Asteroid_Instance::V>	asteroid_instances;
+	Frame_Array<u8>							atlas_pixels; // glyphs rasterized this frame
+	Frame_Array<VBO_Pos_Tex_Col::V>			text_verts; // only lines that are new or moved in the resident text buffer
+	Frame_Array<s32>						text_firsts;
+	Frame_Array<s32>						text_counts;
+	
+	void upload_mesh (u32 slot, v2 const* vertecies, u32 count) {
+		push_cmd(RCMD_UPLOAD_MESH, slot, append(&mesh_verts, {(v2*)vertecies, count}), count);
+		mesh_slots_used = MAX(mesh_slots_used, slot +1);
+	}
+	void draw_world (GLenum primitive, u32 wrap_axes, array<Vertex_Pos_Col> cr verts) {
+		dbg_assert(primitive <= 0xff && wrap_axes < 4);
+		push_cmd(RCMD_DRAW_WORLD, primitive | wrap_axes << 8, append(&world_verts, verts), verts.len);
+	}
+	void draw_asteroids (u32 vertex_count, array<VBO_Asteroid_Instance::V> cr instances) {
+		push_cmd(RCMD_DRAW_ASTEROIDS, vertex_count, append(&asteroid_instances, instances), instances.len);
+	}
+	void upload_glyph (u32 cell, u32 w, array<u8> cr pixels) {
+		dbg_assert(cell <= 0xffff && w > 0 && w <= 0xffff && pixels.len % w == 0);
+		push_cmd(RCMD_UPLOAD_GLYPH, cell | w << 16, append(&atlas_pixels, pixels), pixels.len);
+	}
+	void upload_text (u32 resident_first, array<VBO_Pos_Tex_Col::V> cr verts) {
+		push_cmd(RCMD_UPLOAD_TEXT, resident_first, append(&text_verts, verts), verts.len);
+		text_verts_used = MAX(text_verts_used, resident_first +verts.len);
+	}
+	// one multi draw of lines that are in the resident text buffer
+	void draw_text (array<s32> cr firsts, array<s32> cr counts) {
+		dbg_assert(firsts.len == counts.len);
+		u32 first = append(&text_firsts, firsts);
+		append(&text_counts, counts);
+		push_cmd(RCMD_DRAW_TEXT, 0, first, firsts.len);
+	}
+	
+	void clear () {
+		reset_swap_interval = false;
+		mesh_slots_used = 0;
+		text_verts_used = 0;
+		
+		cmds.clear();
+		mesh_verts.clear();
+		world_verts.clear();
+		asteroid_instances.clear();
+		atlas_pixels.clear();
+		text_verts.clear();
+		text_firsts.clear();
+		text_counts.clear();
+	}
+	
+private:
+	void push_cmd (render_cmd_e type, u32 arg, u32 first, u32 count) {
+		if (count == 0) return;
+		cmds.push({ type, arg, first, count });
+	}
+	template <typename T> static u32 append (Frame_Array<T>* dst, array<T> cr src) {
+		u32 first = dst->pushn(src.len);
+		if (src.len) memcpy(&(*dst)[first], src.arr, src.len * sizeof(T));
+		return first;
+	}
+};
+
+// owns the gl context and draws the recorded frames one frame behind the simulation, so the simulation of frame N+1 overlaps with drawing and swapping frame N
+//  the simulation records into one of the two frames while the render thread executes the other, submit() swaps them
+//  has to start out zeroed (static)
+struct Render_Thread {
+	std::thread				thread;
+	std::mutex				mutex;
+	std::condition_variable	cv;
+	
+	Render_Frame			frames[2];
+	u32						recording_i; // frame the simulation records into, the other one is executed
+	bool					pending; // the other frame was submitted and is not done yet
+	bool					quit;
+	
+	void					(*execute)(Render_Frame* f);
+	
+	bool					serial; // wait for each frame to be drawn in submit, for comparing against the overlapped timing
+	
+	// of the last frame that finished drawing, written by the render thread
+	Render_Stats			done_stats;
+	u64						done_streamed_bytes;
+	f32						done_ms; // executing the commands and swapping
+	
+	// copies of the done_ values made in submit(), only read by the simulation
+	Render_Stats			last_stats;
+	u64						last_streamed_bytes;
+	f32						last_ms;
+	f32						last_submit_wait_ms; // how long the simulation waited for the render thread
+	
+	Render_Frame* recording () {
+		return &frames[recording_i];
+	}
+	
+	// call after all gl resources are created, the context moves to the render thread
+	void start (void (*execute)(Render_Frame* f)) {
+		this->execute = execute;
 		
-		glEnableVertexAttribArray(uv);
-		glVertexAttribPointer(uv,	2, GL_FLOAT, GL_FALSE, sizeof(V), (void*)offsetof(V,uv));
+		glfwMakeContextCurrent(NULL);
+		thread = std::thread([this] () { run(); });
+	}
+	// draws the submitted frame if there is one, then gives the context back to the main thread
+	void stop () {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			quit = true;
+		}
+		cv.notify_all();
+		thread.join();
 		
-		glEnableVertexAttribArray(col);
-		glVertexAttribPointer(col,	4, GL_FLOAT, GL_FALSE, sizeof(V), (void*)offsetof(V,col));
+		glfwMakeContextCurrent(wnd);
+	}
+	
+	// hands the recorded frame over, after waiting for the previous one to finish drawing
+	void submit () {
+		u64 begin = glfwGetTimerValue();
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait(lock, [this] () { return !pending; });
+			
+			recording_i ^= 1;
+			pending = true;
+			cv.notify_all();
+			
+			if (serial) cv.wait(lock, [this] () { return !pending; });
+			
+			last_stats =			done_stats;
+			last_streamed_bytes =	done_streamed_bytes;
+			last_ms =				done_ms;
+		}
+		last_submit_wait_ms = (f32)(glfwGetTimerValue() -begin) * 1000 / (f32)glfwGetTimerFrequency();
 		
+		recording()->clear(); // was drawn before the frame that was just submitted, so it is done
 	}
 	
+private:
+	void run () {
+		glfwMakeContextCurrent(wnd);
+		
+		for (;;) {
+			Render_Frame* f;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cv.wait(lock, [this] () { return pending || quit; });
+				if (!pending) break;
+				
+				f = &frames[recording_i ^ 1];
+			}
+			
+			u64 begin = glfwGetTimerValue();
+			
+			execute(f);
+			
+			stream_buf.end_frame();
+			glfwSwapBuffers(wnd);
+			
+			f32 ms = (f32)(glfwGetTimerValue() -begin) * 1000 / (f32)glfwGetTimerFrequency();
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				done_stats =			render_stats;
+				done_streamed_bytes =	stream_buf.bytes_last_frame;
+				done_ms =				ms;
+				pending = false;
+			}
+			cv.notify_all();
+			
+			render_stats = {};
+		}
+		
+		glfwMakeContextCurrent(NULL);
+	}
 };
+static Render_Thread	render_thread;
+
+#include "soft_raster.hpp"
 #include "font.hpp"
 struct Shader_Clip_Tex_Col : Basic_Shader {
 	Shader_Clip_Tex_Col (): Basic_Shader(
@@ -467,6 +963,27 @@ GLSL_VERSION R"_SHAD(
 	void bind_texture (Texture tex) {
 		glActiveTexture(GL_TEXTURE0 +0);
 		glBindTexture(GL_TEXTURE_2D, tex.gl);
+		++render_stats.state_changes;
+	}
+};
+// same with a distance field texture (Font::sdf), the edge is anti-aliased over one pixel at any scale
+struct Shader_Clip_Tex_Col_Sdf : Shader_Clip_Tex_Col {
+	Shader_Clip_Tex_Col_Sdf () {
+		frag_src =
+// Fragment shader
+GLSL_VERSION R"_SHAD(
+	in		vec4	color;
+	in		vec2	uv;
+	uniform	sampler2D	tex;
+	
+	out		vec4	frag_col;
+	
+	void main() {
+		float dist = texture(tex, uv).r; // 0.5 on the edge
+		float aa = fwidth(dist) * 0.5;
+		frag_col = color * vec4(1,1,1, smoothstep(0.5 -aa, 0.5 +aa, dist));
+	}
+)_SHAD";
 	}
 };
 
@@ -483,54 +1000,209 @@ struct Dbg_Text {
 	
 };
 
+#include "spatial.hpp"
+#include "lbvh.hpp"
+
 namespace asteroids {
 	
 	static Shader_Clip_Tex_Col	shad_tex;
+	static Shader_Clip_Tex_Col_Sdf	shad_tex_sdf;
 	static Shader_World_Col		shad_world_col;
+	static Shader_Asteroid		shad_asteroid;
 	
-	static VBO_Pos_Col			vbo_world_col;
+	static VBO_Pos_Col				vbo_world_col;
+	static VBO_Asteroid_Instance	vbo_asteroid_instance;
 	
 	static v2 world_radius = v2(80, 50);
 	
-	typedef VBO_Pos_Col::V Vertex;
-	
 	v2 wrap (v2 pos) {
 		return mymod(pos +world_radius, world_radius*2) -world_radius;
 	}
 	
-	void draw_with_fake_wrapping (GLenum primitive, array<v2> cr vertecies) {
+	static u32 wrap_copies; // extra primitive copies drawn for fake wrapping this frame
+	static u32 wrap_copies_last_frame;
+	
+	// offsets to the other side of every seam the bounds [lo,hi] stick out over, returns the copy count (0-3)
+	static u32 get_fake_wrap_copies (v2 lo, v2 hi, v2 copies[3]) {
+		v2 shift = 0;
+		if (		hi.x > world_radius.x )		shift.x = world_radius.x * -2;
+		else if (	lo.x < -world_radius.x )	shift.x = world_radius.x * +2;
+		if (		hi.y > world_radius.y )		shift.y = world_radius.y * -2;
+		else if (	lo.y < -world_radius.y )	shift.y = world_radius.y * +2;
+		
+		u32 count = 0;
+		if (shift.x != 0)					copies[count++] = v2(shift.x, 0);
+		if (shift.y != 0)					copies[count++] = v2(0, shift.y);
+		if (shift.x != 0 && shift.y != 0)	copies[count++] = shift;
+		return count;
+	}
+	
+	// world space rect seen through cam.world_to_clip, objects outside of it don't get any vertecies or instances
+	struct View_Rect {
+		v2	lo;
+		v2	hi;
 		
-		constexpr v2 fake_wrap_instances[4] = {
-			v2(0,0),
-			v2(2,0),
-			v2(0,2),
-			v2(2,2),
-		};
+		bool overlaps (v2 obj_lo, v2 obj_hi) const {
+			return obj_hi.x >= lo.x && obj_lo.x <= hi.x && obj_hi.y >= lo.y && obj_lo.y <= hi.y;
+		}
+	};
+	static View_Rect view; // of the frame being rendered
+	
+	static View_Rect get_view_rect () {
+		m2 clip_to_cam2 = inverse( cam.world_to_clip.m2() );
+		v2 a = clip_to_cam2 * v2(-1,-1);
+		v2 b = clip_to_cam2 * v2(+1,+1);
+		return { MIN(a,b) +cam.pos_world, MAX(a,b) +cam.pos_world };
+	}
+	
+	// offsets at which something with the bounds [lo,hi] gets drawn (0 and its fake wrapping copies) that are inside the view, returns their count (0-4)
+	//  *visible_copies gets how many of them are wrap copies
+	static u32 get_visible_offsets (v2 lo, v2 hi, v2 offsets[4], u32* visible_copies) {
+		v2 candidates[4] = { 0 };
+		u32 candidate_count = 1 +get_fake_wrap_copies(lo, hi, &candidates[1]);
 		
-		auto data = array<Vertex>::malloc(arrlen(fake_wrap_instances) * vertecies.len);
-		auto* out = &data[0];
+		u32 count = 0;
+		*visible_copies = 0;
+		for (u32 k=0; k<candidate_count; ++k) {
+			if (!view.overlaps(lo +candidates[k], hi +candidates[k])) continue;
+			
+			offsets[count++] = candidates[k];
+			if (k > 0) ++*visible_copies;
+		}
+		return count;
+	}
+	
+	// instances drawn for a group of primitives that cross the seams along wrap_axes (1: x  2: y  3: both), the first one is the original
+	static u32 get_wrap_instances (u32 wrap_axes) {
+		return wrap_axes == 3 ? 4 : (wrap_axes ? 2 : 1);
+	}
+	// what Shader_World_Col adds to instance i of such a group, always positive since add_with_fake_wrapping moves crossers to the negative side
+	static v2 get_wrap_instance_offset (u32 wrap_axes, u32 i) {
+		s32 x = (wrap_axes & 1) ? i & 1 : 0;
+		s32 y = (wrap_axes & 2) ? (i >> (wrap_axes & 1)) & 1 : 0;
+		return v2((f32)x, (f32)y) * 2 * world_radius;
+	}
+	
+	// all world geometry drawn with shad_world_col, accumulated over the frame and submitted with one upload and one draw per primitive type and wrap axes group
+	//  has to start out zeroed (static)
+	struct World_Batch {
+		Frame_Array<Vertex_Pos_Col>	triangles;
+		Frame_Array<Vertex_Pos_Col>	lines[4]; // by wrap axes (0: none  1: x  2: y  3: both), see add_with_fake_wrapping
+		Frame_Array<Vertex_Pos_Col>	points[4];
+		
+		Frame_Array<Vertex_Pos_Col>* get (GLenum primitive, u32 wrap_axes=0) {
+			switch (primitive) {
+				case GL_TRIANGLES:	dbg_assert(wrap_axes == 0); return &triangles;
+				case GL_LINES:		return &lines[wrap_axes];
+				case GL_POINTS:		return &points[wrap_axes];
+				default: dbg_assert(false); return nullptr;
+			}
+		}
 		
-		v4 col = v4(1);
-		for (v2 fake_wrap : fake_wrap_instances) {
+		void add (GLenum primitive, array<v2> cr vertecies, v4 col) {
+			auto* dst = get(primitive);
+			rgba8 c = pack_rgba8(col);
+		
+			u32 offs = dst->pushn(vertecies.len);
 			for (u32 i=0; i<vertecies.len; ++i) {
-				v2 v = vertecies[i];
+				(*dst)[offs +i] = { vertecies[i], c };
+			}
+		}
+		
+		// primitives (line segments or points) that stick out of the world over a seam get drawn again one world size over on the other side
+		//  the vast majority does not touch a seam and goes into group 0, seam crossers go into the group of the axes they cross, which gets drawn instanced (2 or 4 instances)
+		//  crossers are moved to the negative side here, so that the instances in Shader_World_Col only ever have to add positive offsets
+		//  primitives with no instance in the view are skipped
+		void add_with_fake_wrapping (GLenum primitive, array<v2> cr vertecies, v4 col) {
+			rgba8 c = pack_rgba8(col);
+			
+			u32 prim_verts = primitive == GL_LINES ? 2 : 1;
+			u32 prim_count = vertecies.len / prim_verts;
+			
+			// lines are 1 pixel wide, points 5 (glPointSize)
+			f32 world_per_pixel = cam.radius*2 / (f32)MIN(wnd_dim.x, wnd_dim.y);
+			f32 margin = (primitive == GL_POINTS ? 5 : 1) * 0.5f * world_per_pixel;
+			
+			for (u32 i=0; i<prim_count; ++i) {
+				v2 const* prim = &vertecies[i*prim_verts];
 				
-				v2 object_pos = v;
-				if (primitive == GL_LINES) object_pos = vertecies[i & ~(u32)1];
+				v2 lo = prim[0];
+				v2 hi = prim[0];
+				for (u32 j=1; j<prim_verts; ++j) {
+					lo = MIN(lo, prim[j]);
+					hi = MAX(hi, prim[j]);
+				}
+				lo -= margin;
+				hi += margin;
 				
-				v2 flip_wrap = select(v2(+1),v2(-1), object_pos < 0);
-				v2 fake_wrap_offs = world_radius * fake_wrap*flip_wrap;
+				// the instances cover the same offsets as the original and its copies
+				v2 offsets[4];
+				u32 copies;
+				if (get_visible_offsets(lo, hi, offsets, &copies) == 0) continue;
 				
-				out->pos = v +fake_wrap_offs;
-				out->col = col;
-				++out;
+				u32 axes = 0;
+				v2 shift = 0;
+				if (lo.x < -world_radius.x || hi.x > world_radius.x) {
+					axes |= 1;
+					if (hi.x > world_radius.x) shift.x = world_radius.x * -2;
+				}
+				if (lo.y < -world_radius.y || hi.y > world_radius.y) {
+					axes |= 2;
+					if (hi.y > world_radius.y) shift.y = world_radius.y * -2;
+				}
+				
+				auto* dst = get(primitive, axes);
+				u32 offs = dst->pushn(prim_verts);
+				for (u32 j=0; j<prim_verts; ++j) {
+					(*dst)[offs +j] = { prim[j] +shift, c };
+				}
+				wrap_copies += get_wrap_instances(axes) -1;
 			}
 		}
 		
-		vbo_world_col.upload(data);
+		// same geometry into the software rasterizer, has to happen before record() empties the batches
+		//  it can't draw instanced, so the wrap instances get expanded here
+		void draw_soft (Soft_Raster* r) {
+			Frame_Array<Vertex_Pos_Col>* batches[] =	{ &triangles,				lines,					points };
+			Soft_Raster::prim_e primitives[] =			{ Soft_Raster::TRIANGLES,	Soft_Raster::LINES,		Soft_Raster::POINTS };
+			u32 groups[] =								{ 1,						4,						4 };
+			
+			for (u32 i=0; i<3; ++i) {
+				for (u32 axes=0; axes<groups[i]; ++axes) {
+					auto& batch = batches[i][axes];
+					u32 instances = get_wrap_instances(axes);
+					
+					auto verts = array<Soft_Raster::Vertex>::malloc(batch.len * instances);
+					defer { verts.free(); };
+					
+					for (u32 k=0; k<instances; ++k) {
+						v2 offs = get_wrap_instance_offset(axes, k);
+						for (u32 j=0; j<batch.len; ++j) {
+							auto& v = batch[j];
+							verts[k*batch.len +j] = { v.pos +offs, 0, v4(v.col.r, v.col.g, v.col.b, v.col.a) / 255 };
+						}
+					}
+					r->draw(primitives[i], verts, cam.world_to_clip, {}, 5); // glPointSize(5)
+				}
+			}
+		}
 		
-		glDrawArrays(primitive, 0, data.len);
-	}
+		// records one draw per primitive type and wrap axes group, in the order triangles, lines, points, and empties the batches
+		void record (Render_Frame* f) {
+			f->draw_world(GL_TRIANGLES, 0, triangles);
+			triangles.clear();
+			
+			for (u32 axes=0; axes<4; ++axes) {
+				f->draw_world(GL_LINES, axes, lines[axes]);
+				lines[axes].clear();
+			}
+			for (u32 axes=0; axes<4; ++axes) {
+				f->draw_world(GL_POINTS, axes, points[axes]);
+				points[axes].clear();
+			}
+		}
+	};
+	static World_Batch world_batch;
 	
 	struct Ship {
 		v2	pos;
@@ -550,30 +1222,44 @@ namespace asteroids {
 		};
 		size_e size;
 		
+		u32 mesh_slot; // in asteroid_meshes
+		
 		static constexpr u32 VERTEX_COUNTS[3] = {
 			5,
 			9,
 			12,
 		};
+		// simplified outlines for when an asteroid is only a few pixels big
+		static constexpr u32 OUTLINE_VERTEX_COUNTS[3] = {
+			3,
+			5,
+			6,
+		};
 		static constexpr f32 VERTEX_RADII[3] = {
 			1,
 			3,
 			5,
 		};
+		// generate_mesh never puts vertecies further out than this
+		static constexpr f32 MAX_EXTENT = VERTEX_RADII[BIG] * 1.2f;
 		
 		
 		u32 get_vertex_count () {
 			return VERTEX_COUNTS[size];
 		}
+		f32 get_extent () const {
+			return VERTEX_RADII[size] * 1.2f;
+		}
 		
 		v2 vertecies[VERTEX_COUNTS[BIG]];
 		
-		void generate_mesh () {
+		// per size class, so the vertex count is a compile time constant
+		template <size_e SIZE> void generate_mesh () {
 			// maybe generate mesh based on sin() with different frequencies over circle
 			
-			u32 vertex_count = VERTEX_COUNTS[size];
-			u32 r = VERTEX_RADII[size];
-			dbg_assert(vertex_count == VERTEX_COUNTS[size]);
+			constexpr u32 vertex_count = VERTEX_COUNTS[SIZE];
+			u32 r = VERTEX_RADII[SIZE];
+			dbg_assert(size == SIZE);
 			
 			u32 deep_v = (u32)round(random::f32_01() * (vertex_count-1));
 			dbg_assert(deep_v >= 0 && deep_v < vertex_count);
@@ -597,24 +1283,232 @@ namespace asteroids {
 				vertecies[i] = rotate2(t * RAD_360) * v2(0,random_r());
 			}
 		}
+		void generate_mesh () {
+			switch (size) {
+				case SMALL:		generate_mesh<SMALL>();		break;
+				case MEDIUM:	generate_mesh<MEDIUM>();	break;
+				case BIG:		generate_mesh<BIG>();		break;
+				default: dbg_assert(false);
+			}
+		}
+		
+		// the mesh reduced to OUTLINE_VERTEX_COUNTS[size] vertecies
+		//  repeatedly drops the vertex whose triangle with its neighbours has the least area (Visvalingam-Whyatt), so the notches and spikes that are visible stay
+		void get_outline (v2* out_) const {
+			v2 out[VERTEX_COUNTS[BIG]]; // out_ only has room for the outline
+			
+			u32 count = VERTEX_COUNTS[size];
+			for (u32 i=0; i<count; ++i) out[i] = vertecies[i];
+			
+			while (count > OUTLINE_VERTEX_COUNTS[size]) {
+				u32 least = 0;
+				f32 least_area = BUILTIN_F32_INF;
+				
+				for (u32 i=0; i<count; ++i) {
+					v2 a = out[(i +count -1) % count] -out[i];
+					v2 b = out[(i +1) % count] -out[i];
+					f32 area = abs(a.x*b.y -a.y*b.x);
+					if (area < least_area) {
+						least_area = area;
+						least = i;
+					}
+				}
+				
+				for (u32 i=least; i<count -1; ++i) out[i] = out[i +1];
+				--count;
+			}
+			
+			for (u32 i=0; i<count; ++i) out_[i] = out[i];
+		}
 	};
 	constexpr u32 Asteroid::VERTEX_COUNTS[3];
+	constexpr u32 Asteroid::OUTLINE_VERTEX_COUNTS[3];
 	constexpr f32 Asteroid::VERTEX_RADII[3];
+	constexpr f32 Asteroid::MAX_EXTENT;
 	
 	static dynarr<Asteroid*> asteroids;
 	
+	// all per-session world memory comes from here, reset() discards all of it at once
+	static Arena				world_arena;
+	static Arena_Pool<Asteroid>	asteroid_pool = { &world_arena };
+	
+	// levels of detail of an asteroid, chosen per size class from how big it is on screen
+	enum asteroid_lod_e : u32 {
+		LOD_MESH		=0, // the full mesh
+		LOD_OUTLINE		, // Asteroid::get_outline
+		LOD_POINT		, // a single pixel at the center
+		LOD_COUNT
+	};
+	static cstr asteroid_lod_names[LOD_COUNT] = { "mesh", "outline", "point" };
+	
+	// asteroid meshes never change after generate_mesh, so they get uploaded to the gpu once and Shader_Asteroid reads them through a buffer texture
+	//  every asteroid owns a slot with all of its lods (at LOD_OFFSETS), freed slots get reused
+	//  slots are handed out by the simulation, which records the uploads into the render frame, the buffer itself is only touched by the render thread after init
+	struct Asteroid_Meshes {
+		static constexpr u32 LOD_OFFSETS[LOD_COUNT] = {
+			0,
+			Asteroid::VERTEX_COUNTS[Asteroid::BIG],
+			Asteroid::VERTEX_COUNTS[Asteroid::BIG] +Asteroid::OUTLINE_VERTEX_COUNTS[Asteroid::BIG],
+		};
+		static constexpr u32 SLOT_SIZE = LOD_OFFSETS[LOD_POINT] +1;
+		
+		// render thread
+		GLuint		buf;
+		GLuint		tex;
+		u32			capacity; // in slots
+		
+		// simulation
+		u32			used; // slots handed out since the last reset, including freed ones
+		dynarr<u32>	free_slots;
+		
+		void init (u32 initial_capacity=256) {
+			capacity = initial_capacity;
+			
+			glGenBuffers(1, &buf);
+			glBindBuffer(GL_TEXTURE_BUFFER, buf);
+			glBufferData(GL_TEXTURE_BUFFER, capacity*SLOT_SIZE*sizeof(v2), NULL, GL_STATIC_DRAW);
+			glBindBuffer(GL_TEXTURE_BUFFER, 0);
+			
+			glGenTextures(1, &tex);
+			glBindTexture(GL_TEXTURE_BUFFER, tex);
+			glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32F, buf);
+			glBindTexture(GL_TEXTURE_BUFFER, 0);
+		}
+		
+		// records the upload of the mesh of a, returns its slot
+		u32 alloc (Asteroid const* a) {
+			u32 slot;
+			if (free_slots.len > 0) {
+				slot = free_slots[free_slots.len -1];
+				free_slots.shrink_by(1);
+			} else {
+				slot = used++;
+			}
+			
+			v2 verts[SLOT_SIZE] = {}; // the gaps after the lods of smaller asteroids are never read
+			for (u32 i=0; i<Asteroid::VERTEX_COUNTS[a->size]; ++i) verts[LOD_OFFSETS[LOD_MESH] +i] = a->vertecies[i];
+			a->get_outline(&verts[LOD_OFFSETS[LOD_OUTLINE]]);
+			verts[LOD_OFFSETS[LOD_POINT]] = 0; // the center
+			
+			render_thread.recording()->upload_mesh(slot, verts, SLOT_SIZE);
+			
+			return slot;
+		}
+		void free (u32 slot) {
+			dbg_assert(slot < used);
+			free_slots.push(slot);
+		}
+		void reset () {
+			used = 0;
+			free_slots.realloc(0);
+		}
+		
+		// render thread side of alloc, grows the buffer if the simulation handed out slots past its capacity
+		void upload (Render_Frame cr f, Render_Cmd cr cmd) {
+			while (f.mesh_slots_used > capacity) grow();
+			
+			glBindBuffer(GL_TEXTURE_BUFFER, buf);
+			glBufferSubData(GL_TEXTURE_BUFFER, cmd.arg*SLOT_SIZE*sizeof(v2), cmd.count*sizeof(v2), &f.mesh_verts[cmd.first]);
+			glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		}
+		
+		void bind_texture () {
+			glActiveTexture(GL_TEXTURE0 +Shader_Asteroid::MESHES_TEX_UNIT);
+			glBindTexture(GL_TEXTURE_BUFFER, tex);
+			glActiveTexture(GL_TEXTURE0);
+			++render_stats.state_changes;
+		}
+		
+	private:
+		void grow () {
+			u32 new_capacity = capacity*2;
+			
+			GLuint new_buf;
+			glGenBuffers(1, &new_buf);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, new_buf);
+			glBufferData(GL_COPY_WRITE_BUFFER, new_capacity*SLOT_SIZE*sizeof(v2), NULL, GL_STATIC_DRAW);
+			
+			glBindBuffer(GL_COPY_READ_BUFFER, buf);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, capacity*SLOT_SIZE*sizeof(v2));
+			
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			
+			glDeleteBuffers(1, &buf);
+			buf = new_buf;
+			capacity = new_capacity;
+			
+			glBindTexture(GL_TEXTURE_BUFFER, tex);
+			glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32F, buf);
+			glBindTexture(GL_TEXTURE_BUFFER, 0);
+		}
+	};
+	constexpr u32 Asteroid_Meshes::LOD_OFFSETS[LOD_COUNT];
+	constexpr u32 Asteroid_Meshes::SLOT_SIZE;
+	
+	static Asteroid_Meshes		asteroid_meshes;
+	
+	static void generate_and_upload_mesh (Asteroid* a) {
+		a->generate_mesh();
+		a->mesh_slot = asteroid_meshes.alloc(a);
+	}
+	
 	static void spawn_asteroids (u32 count) {
 		for (u32 i=0; i<count; ++i) {
 			
-			auto* a = (Asteroid*)malloc(sizeof(Asteroid));
+			auto* a = asteroid_pool.alloc();
 			a->pos = random::v2_n1p1() * world_radius;
 			a->vel = rotate2(random::f32_01() * RAD_360) * lerp(4, 7, random::f32_01());
 			a->size = Asteroid::BIG;
-			a->generate_mesh();
+			generate_and_upload_mesh(a);
 			
 			asteroids.push(a);
 		}
 	}
+	// broad phase for queries against the asteroids, selectable at runtime (G cycles through them)
+	//  the grid degrades when the asteroids are clustered (like after a big split cascade), the lbvh does not
+	enum broadphase_e : u32 {
+		BROADPHASE_BRUTE	=0,
+		BROADPHASE_GRID		,
+		BROADPHASE_LBVH		,
+		BROADPHASE_COUNT
+	};
+	static cstr broadphase_names[BROADPHASE_COUNT] = { "brute", "grid", "lbvh" };
+	
+	static broadphase_e		broadphase = BROADPHASE_GRID;
+	
+	// rebuilt every tick and after the splits of a tick, since they refer to asteroids by index
+	static Spatial_Grid		asteroid_grid;
+	static f32				asteroid_grid_cell_size = Asteroid::MAX_EXTENT*2;
+	static LBVH				asteroid_bvh;
+	
+	static void build_asteroid_broadphase () {
+		switch (broadphase) {
+			case BROADPHASE_BRUTE:	break;
+			case BROADPHASE_GRID:
+				asteroid_grid.build(asteroids.len, [] (u32 i) { return asteroids[i]->pos; }, world_radius, asteroid_grid_cell_size);
+				break;
+			case BROADPHASE_LBVH:
+				asteroid_bvh.build(asteroids.len, [] (u32 i) { return asteroids[i]->pos; },
+						[] (u32 i) { return asteroids[i]->get_extent(); }, world_radius);
+				break;
+			default: dbg_assert(false);
+		}
+	}
+	// calls f(u32 ast_i, v2 delta) for asteroids that might touch the circle, delta being the shortest vector from p to the asteroid
+	template <typename FUNC> static void for_each_asteroid_near (v2 p, f32 radius, FUNC f) {
+		switch (broadphase) {
+			case BROADPHASE_BRUTE:
+				for (u32 i=0; i<asteroids.len; ++i) {
+					f(i, torus_delta(p, asteroids[i]->pos, world_radius));
+				}
+				break;
+			case BROADPHASE_GRID:	asteroid_grid.query_radius(p, radius +Asteroid::MAX_EXTENT, f);	break;
+			case BROADPHASE_LBVH:	asteroid_bvh.query(p, radius, f);	break;
+			default: dbg_assert(false);
+		}
+	}
+	
 	static void update_asteroids () {
 		for (u32 i=0; i<asteroids.len; ++i) {
 			auto* a = asteroids[i];
@@ -629,9 +1523,9 @@ namespace asteroids {
 		if (		tmp->size == Asteroid::SMALL ) {
 			
 		} else if (	tmp->size == Asteroid::MEDIUM ) {
-			auto* a = (Asteroid*)malloc(sizeof(Asteroid));
-			auto* b = (Asteroid*)malloc(sizeof(Asteroid));
-			auto* c = (Asteroid*)malloc(sizeof(Asteroid));
+			auto* a = asteroid_pool.alloc();
+			auto* b = asteroid_pool.alloc();
+			auto* c = asteroid_pool.alloc();
 			
 			a->pos = tmp->pos;
 			b->pos = tmp->pos;
@@ -649,17 +1543,17 @@ namespace asteroids {
 			b->vel = tmp->vel +split_vel_b;
 			c->vel = tmp->vel +split_vel_c;
 			
-			a->generate_mesh();
-			b->generate_mesh();
-			c->generate_mesh();
+			generate_and_upload_mesh(a);
+			generate_and_upload_mesh(b);
+			generate_and_upload_mesh(c);
 			
 			asteroids.push(a);
 			asteroids.push(b);
 			asteroids.push(c);
 			
 		} else if (	tmp->size == Asteroid::BIG ) {
-			auto* a = (Asteroid*)malloc(sizeof(Asteroid));
-			auto* b = (Asteroid*)malloc(sizeof(Asteroid));
+			auto* a = asteroid_pool.alloc();
+			auto* b = asteroid_pool.alloc();
 			
 			a->pos = tmp->pos;
 			b->pos = tmp->pos;
@@ -672,8 +1566,8 @@ namespace asteroids {
 			a->vel = tmp->vel +split_vel;
 			b->vel = tmp->vel -split_vel;
 			
-			a->generate_mesh();
-			b->generate_mesh();
+			generate_and_upload_mesh(a);
+			generate_and_upload_mesh(b);
 			
 			asteroids.push(a);
 			asteroids.push(b);
@@ -681,16 +1575,20 @@ namespace asteroids {
 		}
 		
 		asteroids.delete_by_moving_last(i);
-		free(tmp);
+		asteroid_meshes.free(tmp->mesh_slot);
+		asteroid_pool.free(tmp);
 	}
 	
-	static bool test_collison (Asteroid* aster, v2 v) {
+	// per size class, the loop has a constant trip count and no modulo for the closing edge, so it can be fully unrolled
+	template <Asteroid::size_e SIZE> static bool test_collison (Asteroid const* aster, v2 v) {
+		constexpr u32 vertex_count = Asteroid::VERTEX_COUNTS[SIZE];
+		dbg_assert(aster->size == SIZE);
+		
 		v = v -aster->pos;
 		
-		u32 vertex_count = Asteroid::VERTEX_COUNTS[aster->size];
+		v2 a = aster->vertecies[vertex_count -1];
 		for (u32 i=0; i<vertex_count; ++i) {
-			v2 a = aster->vertecies[i];
-			v2 b = aster->vertecies[(i+1) % vertex_count];
+			v2 b = aster->vertecies[i];
 			v2 c = 0.0f;
 			
 			v2 ca = a -c;
@@ -707,10 +1605,42 @@ namespace asteroids {
 			auto u = dot(v -a, ab);
 			if (s >= 0 && t >= 0 && u >= 0) return true;
 			
+			a = b;
 		}
 		
 		return false;
 	}
+	static bool test_collison (Asteroid const* aster, v2 v) {
+		switch (aster->size) {
+			case Asteroid::SMALL:	return test_collison<Asteroid::SMALL>(aster, v);
+			case Asteroid::MEDIUM:	return test_collison<Asteroid::MEDIUM>(aster, v);
+			case Asteroid::BIG:		return test_collison<Asteroid::BIG>(aster, v);
+			default: dbg_assert(false); return false;
+		}
+	}
+	
+	// asteroid indices (of a subset of the asteroids) grouped by size class (counting sort), so size specialized code can be selected once per bucket
+	static dynarr<u32>	asteroids_by_size;
+	static u32			size_bucket_start[4]; // asteroids_by_size[size_bucket_start[size], size_bucket_start[size+1])
+	
+	static void bucket_asteroids_by_size (array<u32> cr indices) {
+		if (asteroids_by_size.len != indices.len) asteroids_by_size.realloc(indices.len);
+		
+		u32 offs[3] = {};
+		for (u32 i : indices) ++offs[asteroids[i]->size];
+		
+		size_bucket_start[0] = 0;
+		for (u32 i=0; i<3; ++i) {
+			size_bucket_start[i +1] = size_bucket_start[i] +offs[i];
+			offs[i] = size_bucket_start[i];
+		}
+		for (u32 i : indices) {
+			asteroids_by_size[ offs[asteroids[i]->size]++ ] = i;
+		}
+	}
+	static array<u32> get_size_bucket (Asteroid::size_e size) {
+		return { &asteroids_by_size.arr[size_bucket_start[size]], size_bucket_start[size +1] -size_bucket_start[size] };
+	}
 	
 	struct Bullet {
 		v2	pos;
@@ -719,22 +1649,40 @@ namespace asteroids {
 		f32	time_to_live;
 	};
 	static dynarr<Bullet*> bullets = {}; // non allocated
+	static Arena_Pool<Bullet> bullet_pool = { &world_arena };
+	
+	// entity arrays get sorted by morton code of their position every this many ticks (M toggles it)
+	//  split_asteroid and delete_by_moving_last scramble the order, sorting keeps neighbouring entities close in memory for the grid and the collision pass
+	static bool	morton_reorder = true;
+	static u32	morton_reorder_interval = 60;
+	static u32	ticks_since_reorder = 0;
+	
+	static void reorder_entities () {
+		// nothing keeps asteroid or bullet indices/pointers across ticks (the grid gets rebuilt), so no remapping needed
+		reorder_by_morton(asteroids, world_radius, [] (Asteroid const* a) { return a->pos; });
+		reorder_by_morton(bullets, world_radius, [] (Bullet const* b) { return b->pos; });
+	}
+	
+	static f32 running_avg_collision_ms = 0;
 	
 	static f32 bullet_muzzle_vel = 60;
 	static f64 t_last_shot = 0;
 	
 	static void shoot (v2 pos, v2 vel) {
 		f32 ttl = 0.9f * world_radius.x*2 / bullet_muzzle_vel;
-		auto* b = (Bullet*)malloc(sizeof(Bullet));
+		auto* b = bullet_pool.alloc();
 		*b = {pos, vel, ttl};
 		t_last_shot = t;	
 		
 		bullets.push(b);
 	}
+	static dynarr<u8> asteroid_hit; // per asteroid index, static so it starts out zeroed
+	
 	static void update_bullets () {
 		// cull expired bullets
 		for (u32 i=0; i<bullets.len;) {
 			if (bullets[i]->time_to_live <= 0) {
+				bullet_pool.free(bullets[i]);
 				bullets.delete_by_moving_last(i);
 				continue; // 
 			}
@@ -742,32 +1690,48 @@ namespace asteroids {
 			++i;
 		}
 		// bullets split asteroids
-		auto test_asteroids_collison = [&] (Bullet* b) -> Asteroid* {
-			for (u32 i=0; i<asteroids.len; ++i) {
-				if (test_collison(asteroids[i], b->pos)) return asteroids[i];
-			}
-			return nullptr;
-		};
+		u64 collision_begin = glfwGetTimerValue();
+		
+		build_asteroid_broadphase();
+		
+		// the splits wait until every bullet is tested, so the broadphase stays valid for the whole loop
+		//  an asteroid splits at most once per tick, further bullets fly through it and can hit its children next tick
+		asteroid_hit.realloc(asteroids.len);
+		memset(asteroid_hit.arr, 0, asteroid_hit.len);
+		u32 hits = 0;
+		
 		for (u32 i=0; i<bullets.len;) {
 			
-			bool coll = false;
-			u32 ast_i=0;
-			for (; ast_i<asteroids.len; ++ast_i) {
-				if (test_collison(asteroids[ast_i], bullets[i]->pos)) {
-					coll = true;
-					break;
-				}
-			}
+			s32 hit = -1;
+			for_each_asteroid_near(bullets[i]->pos, 0, [&] (u32 ast_i, v2 delta) {
+				// delta points from the bullet to the asteroid across the seam if that is shorter
+				if (hit < 0 && !asteroid_hit[ast_i] && test_collison(asteroids[ast_i], asteroids[ast_i]->pos -delta)) hit = (s32)ast_i;
+			});
 			
-			if (coll) {
-				free(bullets[i]);
+			if (hit >= 0) {
+				bullet_pool.free(bullets[i]);
 				bullets.delete_by_moving_last(i);
 				
-				split_asteroid(ast_i);
+				asteroid_hit[hit] = 1;
+				++hits;
 			} else {
 				++i;
 			}
 		}
+		
+		if (hits) {
+			// backwards, delete_by_moving_last only moves children or asteroids that were already looked at into i
+			for (u32 i=asteroid_hit.len; i-- > 0;) {
+				if (asteroid_hit[i]) split_asteroid(i);
+			}
+			build_asteroid_broadphase();
+		}
+		
+		{
+			f32 ms = (f32)(glfwGetTimerValue() -collision_begin) * 1000 / (f32)glfwGetTimerFrequency();
+			f32 alpha = 0.025f;
+			running_avg_collision_ms = running_avg_collision_ms*(1.0f -alpha) +ms*alpha;
+		}
 		// bullet physics
 		for (u32 i=0; i<bullets.len; ++i) {
 			auto* b = bullets[i];
@@ -781,9 +1745,138 @@ namespace asteroids {
 	
 	f32			running_avg_fps;
 	
+	// main thread work, render thread work and wall time per frame, the sum of the first two minus the wall time is what running them in parallel saved
+	f32			running_avg_sim_ms;
+	f32			running_avg_render_ms;
+	f32			running_avg_frame_ms;
+	
 	array<utf8>	dbg_name_and_fps = {}; // non_allocated
 	array<utf8>	wnd_title = {}; // non_allocated
 	array<utf8>	info = {}; // non_allocated
+	array<utf8>	render_info = {}; // non_allocated
+	
+	static u32 visible_asteroids; // asteroids with at least one instance this frame
+	static u32 visible_asteroids_last_frame;
+	
+	static bool asteroid_lods = true; // L toggles, to compare against always drawing the full meshes
+	
+	// the camera has no perspective, so all asteroids of a size class are the same size on screen
+	static asteroid_lod_e choose_asteroid_lod (Asteroid::size_e size) {
+		if (!asteroid_lods) return LOD_MESH;
+		
+		f32 pixels_per_world = (f32)MIN(wnd_dim.x, wnd_dim.y) / (cam.radius*2);
+		f32 diameter_px = Asteroid::VERTEX_RADII[size]*2 * pixels_per_world;
+		
+		if (diameter_px < 2)	return LOD_POINT;
+		if (diameter_px < 16)	return LOD_OUTLINE; // the dropped vertecies would move the outline by about a pixel
+		return LOD_MESH;
+	}
+	static u32 get_lod_vertex_count (Asteroid::size_e size, asteroid_lod_e lod) {
+		switch (lod) {
+			case LOD_MESH:		return Asteroid::VERTEX_COUNTS[size];
+			case LOD_OUTLINE:	return Asteroid::OUTLINE_VERTEX_COUNTS[size];
+			case LOD_POINT:		return 1;
+			default: dbg_assert(false); return 0;
+		}
+	}
+	
+	// indices of the asteroids that could be in view, from the broadphase when zoomed in, all of them otherwise
+	//  only a first cut, emit_asteroid_instances culls the exact bounds of the asteroids and their wrap copies
+	static array<u32> get_asteroid_candidates_in_view (f32 margin) {
+		static dynarr<u32> candidates; // static so it starts out zeroed
+		candidates.realloc(0);
+		
+		v2 center = wrap((view.lo +view.hi) * 0.5f);
+		f32 radius = length(view.hi -view.lo) * 0.5f +margin;
+		
+		// the grid visits cells twice once the query wraps around the whole world
+		bool use_broadphase = broadphase != BROADPHASE_BRUTE && radius +Asteroid::MAX_EXTENT*2 < MIN(world_radius.x, world_radius.y);
+		
+		if (use_broadphase) {
+			for_each_asteroid_near(center, radius, [&] (u32 i, v2 delta) {
+				candidates.push(i);
+			});
+		} else {
+			candidates.realloc(asteroids.len);
+			for (u32 i=0; i<asteroids.len; ++i) candidates[i] = i;
+		}
+		return candidates;
+	}
+	
+	// instance records of the asteroids of one size class that are in view, plus a fake wrapping copy on the other side of every seam an asteroid crosses (if that one is in view)
+	static VBO_Asteroid_Instance::V* emit_asteroid_instances (array<u32> bucket, asteroid_lod_e lod, VBO_Asteroid_Instance::V* out) {
+		f32 margin = 0.5f * cam.radius*2 / (f32)MIN(wnd_dim.x, wnd_dim.y); // lines are 1 pixel wide
+		
+		for (u32 i : bucket) {
+			auto* a = asteroids[i];
+			f32 r = a->get_extent() +margin;
+			
+			v2 offsets[4];
+			u32 copies;
+			u32 count = get_visible_offsets(a->pos -r, a->pos +r, offsets, &copies);
+			
+			VBO_Asteroid_Instance::V inst;
+			inst.mesh_offs =	(s32)(a->mesh_slot * Asteroid_Meshes::SLOT_SIZE +Asteroid_Meshes::LOD_OFFSETS[lod]);
+			
+			for (u32 k=0; k<count; ++k) {
+				inst.pos = a->pos +offsets[k];
+				*out++ = inst;
+			}
+			wrap_copies += copies;
+			visible_asteroids += count > 0 ? 1 : 0;
+		}
+		return out;
+	}
+	
+	// software rendered frames (F12), written to soft_frame.bmp
+	static Soft_Raster soft_raster;
+	
+	// asteroid outlines as line segments from the cpu side meshes (or points), with the same lods, culling and wrap copies as emit_asteroid_instances (not counted again)
+	//  uses asteroids_by_size, so has to happen after bucket_asteroids_by_size
+	static void draw_asteroids_soft (Soft_Raster* r) {
+		f32 margin = 0.5f * cam.radius*2 / (f32)MIN(wnd_dim.x, wnd_dim.y);
+		
+		static dynarr<Soft_Raster::Vertex> lines; // static so they start out zeroed
+		static dynarr<Soft_Raster::Vertex> points;
+		lines.realloc(0);
+		points.realloc(0);
+		
+		for (u32 ast_i : asteroids_by_size) {
+			auto* a = asteroids[ast_i];
+			f32 r = a->get_extent() +margin;
+			
+			asteroid_lod_e lod = choose_asteroid_lod(a->size);
+			u32 vertex_count = get_lod_vertex_count(a->size, lod);
+			
+			v2 outline[Asteroid::VERTEX_COUNTS[Asteroid::BIG]];
+			v2 const* mesh = a->vertecies;
+			if (lod == LOD_OUTLINE) {
+				a->get_outline(outline);
+				mesh = outline;
+			}
+			
+			v2 offsets[4];
+			u32 copies;
+			u32 offset_count = get_visible_offsets(a->pos -r, a->pos +r, offsets, &copies);
+			
+			for (u32 k=0; k<offset_count; ++k) {
+				v2 p = a->pos +offsets[k];
+				
+				if (lod == LOD_POINT) {
+					points.push({ p, 0, v4(1) });
+					continue;
+				}
+				
+				u32 offs = lines.pushn(vertex_count*2);
+				for (u32 i=0; i<vertex_count; ++i) {
+					lines[offs +i*2 +0] = { p +mesh[i], 0, v4(1) };
+					lines[offs +i*2 +1] = { p +mesh[(i +1) % vertex_count], 0, v4(1) };
+				}
+			}
+		}
+		r->draw(Soft_Raster::LINES, lines, cam.world_to_clip);
+		r->draw(Soft_Raster::POINTS, points, cam.world_to_clip, {}, 1);
+	}
 	
 	static void reset () {
 		ship = Ship{0,0,0};
@@ -791,12 +1884,23 @@ namespace asteroids {
 		bullets.realloc(0);
 		asteroids.realloc(0);
 		
+		world_arena.reset();
+		asteroid_pool.reset();
+		asteroid_meshes.reset();
+		bullet_pool.reset();
+		
 		spawn_asteroids(10);
 	}
-	static void init  () {
+	// the parts of init that do not need the window, also used by the headless mode
+	static void init_view () {
 		cam.pos_world = v2(0);
 		cam.radius = MAX(world_radius.x, world_radius.y)*1.0f;
 		
+		running_avg_fps = 60; // assume 60 fps initially
+	}
+	static void init  () {
+		init_view();
+		
 		auto mr = get_monitor_rect();
 		#if 0
 		s32 border_top =		31;			// window title
@@ -813,24 +1917,36 @@ namespace asteroids {
 		#endif
 		init_show_window(false, r);
 		
-		running_avg_fps = 60; // assume 60 fps initially
-		
 		shad_tex.init();
+		shad_tex_sdf.init();
 		shad_world_col.init();
+		shad_asteroid.init();
+		
 		vbo_world_col.init();
+		vbo_asteroid_instance.init();
+		
+		asteroid_meshes.init();
 		
-		reset();
+		// reset() (the world) runs on a startup thread, it does not need the context
 	}
 	
+	static bool soft_frame_next; // headless mode, render the next frame on the cpu as if F12 was pressed
+	
 	static void frame () {
 		
 		if (frame_indx != 0) {
 			f32 alpha = 0.025f;
 			running_avg_fps = running_avg_fps*(1.0f -alpha) +(1.0f/dt)*alpha;
+			
+			f32 frame_ms = dt*1000;
+			f32 sim_ms = frame_ms -render_thread.last_submit_wait_ms;
+			running_avg_sim_ms =	running_avg_sim_ms*(1.0f -alpha) +sim_ms*alpha;
+			running_avg_render_ms =	running_avg_render_ms*(1.0f -alpha) +render_thread.last_ms*alpha;
+			running_avg_frame_ms =	running_avg_frame_ms*(1.0f -alpha) +frame_ms*alpha;
 		}
 		{
 			print_array(&wnd_title, "%s    ~%.1f fps", game_name, running_avg_fps);
-			glfwSetWindowTitle(wnd, wnd_title.arr);
+			if (wnd) glfwSetWindowTitle(wnd, wnd_title.arr); // no window in headless mode
 			
 			
 			print_array(&dbg_name_and_fps, "%s  ~%.1f fps  %.3f ms", PROJECT_NAME, running_avg_fps, dt*1000);
@@ -840,6 +1956,10 @@ namespace asteroids {
 		
 		if (button_went_down(B_R))	reset();
 		if (button_went_down(B_B))	split_asteroid(0);
+		if (button_went_down(B_M))	morton_reorder = !morton_reorder;
+		if (button_went_down(B_G))	broadphase = (broadphase_e)((broadphase +1) % BROADPHASE_COUNT);
+		if (button_went_down(B_O))	render_thread.serial = !render_thread.serial;
+		if (button_went_down(B_L))	asteroid_lods = !asteroid_lods;
 		
 		//
 		{
@@ -876,45 +1996,72 @@ namespace asteroids {
 			//ship.pos = cursor_pos_world;
 			ship.pos = wrap(ship.pos);
 			
+			if (morton_reorder && ++ticks_since_reorder >= morton_reorder_interval) {
+				reorder_entities();
+				ticks_since_reorder = 0;
+			}
+			
 			update_asteroids();
 			update_bullets();
 		}
-		print_array(&info, "%.1f %.1f sv: %.2f bullets: %d asteroids %d",
-				ship.pos.x,ship.pos.y, length(ship.vel), bullets.len, asteroids.len);
+		wrap_copies_last_frame = wrap_copies;
+		wrap_copies = 0;
+		visible_asteroids_last_frame = visible_asteroids;
+		visible_asteroids = 0;
+		
+		print_array(&info, "%.1f %.1f sv: %.2f bullets: %d asteroids %d (%u in view)  world mem: %llu/%llu KB  collision: %.3f ms (%s, morton %s)  streamed: %llu KB/frame  wrap copies: %u  draws: %u  state changes: %u",
+				ship.pos.x,ship.pos.y, length(ship.vel), bullets.len, asteroids.len, visible_asteroids_last_frame,
+				world_arena.used/1024, world_arena.reserved/1024,
+				running_avg_collision_ms, broadphase_names[broadphase], morton_reorder ? "on" : "off",
+				render_thread.last_streamed_bytes/1024, wrap_copies_last_frame,
+				render_thread.last_stats.draw_calls, render_thread.last_stats.state_changes);
+				
+		print_array(&render_info, "render thread (O): %s  sim: %.2f ms  render: %.2f ms  frame: %.2f ms  overlap saved: %.2f ms  asteroid lods (L): %s %s %s  text lines: %u (%u laid out)  glyphs rasterized: %u",
+				render_thread.serial ? "serial" : "overlapped",
+				running_avg_sim_ms, running_avg_render_ms, running_avg_frame_ms,
+				running_avg_sim_ms +running_avg_render_ms -running_avg_frame_ms,
+				asteroid_lod_names[choose_asteroid_lod(Asteroid::SMALL)],
+				asteroid_lod_names[choose_asteroid_lod(Asteroid::MEDIUM)],
+				asteroid_lod_names[choose_asteroid_lod(Asteroid::BIG)],
+				dbg_font.lines_last_frame, dbg_font.rebuilds_last_frame, dbg_font.glyphs_rasterized_last_frame);
 		
 		v4 background_out_of_world_col = v4( srgb(80,52,60) * 0.25f, 1 );
 		v4 background_col = v4( srgb(41,49,52) * 0.25f, 1 );
 		
-		glViewport(0, 0, wnd_dim.x, wnd_dim.y);
-		
-		glClearColor(background_out_of_world_col.x, background_out_of_world_col.y, background_out_of_world_col.z, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
+		// also render this frame on the cpu, to check the software rasterizer against the gpu
+		bool soft_frame = button_went_down(B_F12) || soft_frame_next;
+		if (soft_frame) {
+			soft_raster.init(wnd_dim.x, wnd_dim.y);
+			soft_raster.clear(background_out_of_world_col);
+		}
 		
-		shad_world_col.bind();
-		shad_world_col.world_to_clip.set( cam.world_to_clip );
+		Render_Frame* rf = render_thread.recording();
+		rf->viewport =				wnd_dim;
+		rf->clear_col =				background_out_of_world_col;
+		rf->world_to_clip =			cam.world_to_clip;
+		rf->reset_swap_interval =	reset_swap_interval;
+		reset_swap_interval = false;
 		
-		vbo_world_col.bind(shad_world_col);
+		view = get_view_rect();
 		
 		{ // World rect
 			
-			auto data = array<Vertex>{
-				{ world_radius*v2(+1,-1), background_col },
-				{ world_radius*v2(+1,+1), background_col },
-				{ world_radius*v2(-1,-1), background_col },
-				{ world_radius*v2(-1,-1), background_col },
-				{ world_radius*v2(+1,+1), background_col },
-				{ world_radius*v2(-1,+1), background_col },
+			v2 data[] = { // not array<v2>{}, that would point into an initializer_list that is gone after this statement
+				world_radius*v2(+1,-1),
+				world_radius*v2(+1,+1),
+				world_radius*v2(-1,-1),
+				world_radius*v2(-1,-1),
+				world_radius*v2(+1,+1),
+				world_radius*v2(-1,+1),
 			};
 			
-			vbo_world_col.upload(data);
-			
-			glDrawArrays(GL_TRIANGLES, 0, data.len);
+			world_batch.add(GL_TRIANGLES, data, background_col);
 		}
 		
 		{
 			m2 r = rotate2(ship.ori);
 			
-			auto ship_verts = array<v2>{
+			v2 ship_verts[] = {
 				r*v2( 0, 0) +ship.pos,
 				r*v2(+1,-1) +ship.pos,
 				
@@ -928,7 +2075,7 @@ namespace asteroids {
 				r*v2( 0, 0) +ship.pos,
 			};
 			
-			draw_with_fake_wrapping(GL_LINES, ship_verts);
+			world_batch.add_with_fake_wrapping(GL_LINES, ship_verts, v4(1));
 		}
 		if (bullets.len > 0) {
 			
@@ -939,89 +2086,293 @@ namespace asteroids {
 				verts[i] = bullets[i]->pos;
 			}
 			
-			draw_with_fake_wrapping(GL_POINTS, verts);
+			world_batch.add_with_fake_wrapping(GL_POINTS, verts, v4(1));
 		}
+		
+		if (soft_frame) world_batch.draw_soft(&soft_raster);
+		world_batch.record(rf);
+		
 		if (asteroids.len > 0) {
-			v4 col = v4(1);
+			f32 margin = 0.5f * cam.radius*2 / (f32)MIN(wnd_dim.x, wnd_dim.y);
+			bucket_asteroids_by_size( get_asteroid_candidates_in_view(margin) );
 			
-			auto verts = array<v2>::malloc(Asteroid::VERTEX_COUNTS[Asteroid::BIG]*2 * asteroids.len); // large enough
-			defer { verts.free(); };
-			v2* out = &verts[0];
+			if (soft_frame) draw_asteroids_soft(&soft_raster);
 			
-			for (auto& a : asteroids) {
-				u32 count = a->get_vertex_count();
-				for (u32 j=0; j<count; ++j) {
-					*out++ = a->vertecies[j] +a->pos;
-					*out++ = a->vertecies[(j+1)%count] +a->pos;
-				}
-			}
+			// one instance record per visible asteroid (and wrap copy) instead of all edges, one draw per size class since the vertex count per instance is fixed
+			//  the lod is the same for a whole size class, so it only changes which part of the mesh slots the instances point to
+			auto instances = array<VBO_Asteroid_Instance::V>::malloc(4 * MAX(asteroids_by_size.len, 1u)); // large enough
+			defer { instances.free(); };
+			auto* out = &instances[0];
 			
-			verts.len = verts.get_i(out);
+			asteroid_lod_e lods[3];
+			u32 size_start[4];
+			for (u32 size=0; size<3; ++size) {
+				lods[size] = choose_asteroid_lod((Asteroid::size_e)size);
+				
+				size_start[size] = instances.get_i(out);
+				out = emit_asteroid_instances(get_size_bucket((Asteroid::size_e)size), lods[size], out);
+			}
+			size_start[3] = instances.get_i(out);
+			instances.len = size_start[3];
 			
-			draw_with_fake_wrapping(GL_LINES, verts);
+			for (u32 size=0; size<3; ++size) {
+				rf->draw_asteroids(get_lod_vertex_count((Asteroid::size_e)size, lods[size]),
+						{ &instances[size_start[size]], size_start[size +1] -size_start[size] });
+			}
 		}
 		#if 0 // colission visualization
 		if (asteroids.len > 0) {
 			
 			for (auto& a : asteroids) {
-				Vertex data[20][20];
+				Vertex_Pos_Col data[20][20];
 				
 				auto count = Asteroid::VERTEX_COUNTS[ a->size ];
 				
 				for (u32 j=0; j<20; ++j) {
 					for (u32 i=0; i<20; ++i) {
 						data[j][i].pos = a->pos +7 * ((v2)iv2(i,j) / 19 * 2 -1);
-						data[j][i].col = test_collison(a, data[j][i].pos) ? v4(1,0.25f,0.25f,1) :  v4(0.25f,1,0.25f,1);
+						data[j][i].col = pack_rgba8( test_collison(a, data[j][i].pos) ? v4(1,0.25f,0.25f,1) :  v4(0.25f,1,0.25f,1) );
 					}
 				}
 				
-				vbo_world_col.upload({&data[0][0], 20*20});
-				
-				glDrawArrays(GL_POINTS, 0, 20*20);
+				rf->draw_world(GL_POINTS, 0, {&data[0][0], 20*20});
 			}
 		}
 		#endif
 		
 		
-		shad_tex.bind();
-		shad_tex.bind_texture(dbg_font.tex);
-		
 		dbg_font.draw_text_lines(shad_tex, dbg_name_and_fps,	v2(2, -3 +17*1), 1);
 		dbg_font.draw_text_lines(shad_tex, info,				v2(2, -3 +17*2), 1);
+		dbg_font.draw_text_lines(shad_tex, render_info,			v2(2, -3 +17*3), 1);
+		
+		if (soft_frame) dbg_font.draw_soft(&soft_raster);
+		dbg_font.record(rf);
 		
+		if (soft_frame) {
+			u64 begin = glfwGetTimerValue();
+			soft_raster.flush();
+			f32 ms = (f32)(glfwGetTimerValue() -begin) * 1000 / (f32)glfwGetTimerFrequency();
 		
+			bool ok = soft_raster.dump("soft_frame.bmp");
+			printf("software frame %dx%d: %.3f ms, %llu pixels written, %s\n", wnd_dim.x, wnd_dim.y, ms,
+					soft_raster.pixels_written, ok ? "written to soft_frame.bmp" : "could not write soft_frame.bmp");
+		}
+	}
+	
+	// render thread, the only place that makes gl calls after init
+	static void execute_render_frame (Render_Frame* f) {
+		glViewport(0, 0, f->viewport.x, f->viewport.y);
+		
+		if (f->reset_swap_interval) glfwSwapInterval(1);
+		
+		glClearColor(f->clear_col.x, f->clear_col.y, f->clear_col.z, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		
+		// one upload per vertex array, reserved together up front since the draws below refer to both
+		stream_buf.reserve(vbo_world_col.upload_size(f->world_verts) +vbo_asteroid_instance.upload_size(f->asteroid_instances));
+		
+		s32 world_first =		vbo_world_col.upload(f->world_verts);
+		s32 instances_first =	vbo_asteroid_instance.upload(f->asteroid_instances);
+		
+		// uniforms and textures only once per frame
+		bool world_setup = false;
+		u32 world_wrap_axes = 0;
+		bool asteroid_setup = false;
+		bool text_setup = false;
+		
+		for (auto& cmd : f->cmds) {
+			switch (cmd.type) {
+				case RCMD_UPLOAD_MESH: {
+					asteroid_meshes.upload(*f, cmd);
+				} break;
+				
+				case RCMD_DRAW_WORLD: {
+					GLenum primitive = cmd.arg & 0xff;
+					u32 wrap_axes = cmd.arg >> 8;
+					
+					shad_world_col.bind();
+					if (!world_setup) {
+						shad_world_col.world_to_clip.set( f->world_to_clip );
+						shad_world_col.world_radius.set( world_radius );
+						shad_world_col.wrap_axes.set( 0 );
+						world_setup = true;
+					}
+					if (wrap_axes != world_wrap_axes) {
+						shad_world_col.wrap_axes.set( (s32)wrap_axes );
+						world_wrap_axes = wrap_axes;
+					}
+					vbo_world_col.bind();
+					draw_arrays(primitive, world_first +cmd.first, cmd.count, get_wrap_instances(wrap_axes));
+				} break;
+				
+				case RCMD_DRAW_ASTEROIDS: {
+					shad_asteroid.bind();
+					if (!asteroid_setup) {
+						shad_asteroid.world_to_clip.set( f->world_to_clip );
+						asteroid_meshes.bind_texture();
+						asteroid_setup = true;
+					}
+					vbo_asteroid_instance.bind(instances_first +cmd.first);
+					if (cmd.arg == 1) {
+						glPointSize(1); // sub-pixel asteroids, the world points (bullets) are 5
+						draw_arrays(GL_POINTS, 0, 1, cmd.count);
+						glPointSize(5);
+						render_stats.state_changes += 2;
+					} else {
+						draw_arrays(GL_LINE_LOOP, 0, cmd.arg, cmd.count); // every instance is its own loop
+					}
+				} break;
+				
+				case RCMD_UPLOAD_GLYPH: {
+					dbg_font.upload_glyph(*f, cmd);
+				} break;
+				
+				case RCMD_UPLOAD_TEXT: {
+					dbg_font.upload(*f, cmd);
+				} break;
+				
+				case RCMD_DRAW_TEXT: {
+					auto& shad = dbg_font.sdf ? shad_tex_sdf : shad_tex;
+					shad.bind();
+					if (!text_setup) {
+						shad.bind_texture(dbg_font.tex);
+						text_setup = true;
+					}
+					dbg_font.bind();
+					glMultiDrawArrays(GL_TRIANGLES, &f->text_firsts[cmd.first], &f->text_counts[cmd.first], cmd.count);
+					++render_stats.draw_calls;
+				} break;
+				
+				default: dbg_assert(false);
+			}
+		}
 	}
 	
 }
 
-int main (int argc, char** argv) {
+// startup
+//  the cpu heavy parts (loading or packing the font atlas, generating the world) run on their own threads while the main thread creates the window and context and compiles the shaders
+//  they only get joined right before their results have to go to gl, every phase is timed from the start of main so the report shows the overlap
+struct Startup_Phase {
+	cstr	thread;
+	cstr	name;
+	f32		begin_ms;
+	f32		end_ms;
+};
+static std::chrono::steady_clock::time_point	startup_begin;
+
+template <typename FUNC> static Startup_Phase startup_phase (cstr thread, cstr name, FUNC f) {
+	auto ms = [] () { return std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() -startup_begin).count(); };
+	Startup_Phase p = { thread, name, ms(), 0 };
+	f();
+	p.end_ms = ms();
+	return p;
+}
+static void print_startup_report (array<Startup_Phase> cr phases) {
+	f32 total = 0;
+	for (auto& p : phases) total = MAX(total, p.end_ms);
 	
-	//random::init_same_seed_everytime();
-	random::init();
+	printf("startup: %.1f ms\n", total);
+	for (auto& p : phases) {
+		printf("  %-6s  %-36s %7.1f -%7.1f ms  (%.1f ms)\n", p.thread, p.name, p.begin_ms, p.end_ms, p.end_ms -p.begin_ms);
+	}
+}
+
+static void calc_world_to_clip () {
+	f32 radius_scale = 1.0f / cam.radius;
+	v2 scale;
+	if (wnd_dim.x > wnd_dim.y) {
+		scale = v2(wnd_dim_aspect.y * radius_scale, radius_scale);
+	} else {
+		scale = v2(radius_scale, wnd_dim_aspect.x * radius_scale);
+	}
+	
+	cam.world_to_clip = scale4(v3(scale, 1)) * translate4(v3(-cam.pos_world, 0));
+}
+
+// --headless [frames]: no window, no context and no render thread, so it works on machines without a gpu
+//  simulates frames (60 by default) with fixed input and window size, their render frames are recorded like normal and thrown away
+//  the last one is also drawn by the software rasterizer, like F12, so soft_frame.bmp shows what the game looks like at that point
+static int run_headless (u32 frames) {
+	dbg_assert( glfwInit() ); // only for the timer, which needs neither a window nor a gpu
 	
-	setup_glfw();
+	wnd_dim = iv2(1280, 720);
+	wnd_dim_aspect = (v2)wnd_dim / v2((f32)wnd_dim.y, (f32)wnd_dim.x);
 	
-	glEnable(GL_FRAMEBUFFER_SRGB);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	asteroids::init_view();
+	calc_world_to_clip();
 	
-	glPointSize(5);
+	for (frame_indx=0; frame_indx<frames; ++frame_indx) {
+		asteroids::soft_frame_next = frame_indx == frames -1;
+		asteroids::frame();
+		
+		render_thread.recording()->clear(); // instead of submit()
+	}
 	
-	//glfwSwapInterval(1);
+	glfwTerminate();
+	return 0;
+}
+
+int main (int argc, char** argv) {
+	startup_begin = std::chrono::steady_clock::now();
 	
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	//random::init_same_seed_everytime();
+	random::init(); // before the world thread uses it
+	
+	//dbg_font.load("c:/windows/fonts/times.ttf"	, 16);
+	//dbg_font.load("c:/windows/fonts/arialbd.ttf", 16);
+	//dbg_font.load("c:/windows/fonts/consola.ttf", 16, true); // distance field atlas, draw_text_lines works at any size then
+	bool headless = false;
+	u32 headless_frames = 60;
+	for (int i=1; i<argc; ++i) {
+		if (strcmp(argv[i], "--headless") == 0) {
+			headless = true;
+			if (i +1 < argc && atoi(argv[i +1]) > 0) headless_frames = (u32)atoi(argv[++i]);
+		}
+	}
 	
-	{ // for ogl 3.3 and up (i'm not using vaos)
-		GLuint vao;
-		glGenVertexArrays(1, &vao);
-		glBindVertexArray(vao);
+	Startup_Phase font_phase, world_phase;
+	std::thread font_thread ([&] () {
+		font_phase = startup_phase("font", "font atlas", [] () { dbg_font.load("c:/windows/fonts/consola.ttf", 16); });
+	});
+	std::thread world_thread ([&] () {
+		world_phase = startup_phase("world", "world", [] () { asteroids::reset(); }); // only records the mesh uploads, the render thread does them
+	});
+	
+	if (headless) {
+		font_thread.join();
+		world_thread.join();
+		return run_headless(headless_frames);
 	}
 	
-	//dbg_font.init("c:/windows/fonts/times.ttf"	, 16);
-	//dbg_font.init("c:/windows/fonts/arialbd.ttf", 16);
-	dbg_font.init("c:/windows/fonts/consola.ttf", 16);
+	auto window =		startup_phase("main", "window and context",	[] () {
+		setup_glfw();
+		
+		glEnable(GL_FRAMEBUFFER_SRGB);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		
+		glPointSize(5);
+		
+		//glfwSwapInterval(1);
+		
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		
+		stream_buf.init(); // before any vertex format init, their vaos refer to it
+	});
+	auto shaders =		startup_phase("main", "shaders and buffers",	[] () { asteroids::init(); });
+	auto font_wait =	startup_phase("main", "wait for font",			[&] () { font_thread.join(); });
+	auto font_upload =	startup_phase("main", "font upload",			[] () { dbg_font.init_gl(); });
+	auto world_wait =	startup_phase("main", "wait for world",			[&] () { world_thread.join(); });
 	
-	asteroids::init();
+	font_phase.name = dbg_font.atlas_baked ? "font atlas (packed and baked)" : "font atlas (from the baked blob)";
+	
+	Startup_Phase phases[] = { window, shaders, font_wait, font_upload, world_wait, font_phase, world_phase };
+	print_startup_report({ phases, arrlent(u32, phases) });
+	printf("font atlas: %ux%u (%u KB), packed glyphs %.1f%% occupied\n",
+			dbg_font.tex.w, dbg_font.tex.h, dbg_font.tex.w*dbg_font.tex.h / 1024, dbg_font.packed_occupancy * 100);
+			
+	render_thread.start(asteroids::execute_render_frame);
 	
 	bool	dragging = false;
 	v2		dragging_grab_pos_world;
@@ -1059,18 +2410,6 @@ int main (int argc, char** argv) {
 			cursor_in_wnd =	   cursor_pos.x >= 0 && cursor_pos.x < wnd_dim.x
 							&& cursor_pos.y >= 0 && cursor_pos.y < wnd_dim.y;
 			
-			auto calc_world_to_clip = [] () {
-				f32 radius_scale = 1.0f / cam.radius;
-				v2 scale;
-				if (wnd_dim.x > wnd_dim.y) {
-					scale = v2(wnd_dim_aspect.y * radius_scale, radius_scale);
-				} else {
-					scale = v2(radius_scale, wnd_dim_aspect.x * radius_scale);
-				}
-				
-				cam.world_to_clip = scale4(v3(scale, 1)) * translate4(v3(-cam.pos_world, 0));
-			};
-			
 			// TODO: is it possible to not calculate this 3 times per frame without changing the behavoir?
 			calc_world_to_clip();
 			
@@ -1118,7 +2457,7 @@ int main (int argc, char** argv) {
 		
 		asteroids::frame();
 		
-		glfwSwapBuffers(wnd);
+		render_thread.submit();
 		
 		{
 			u64 now = glfwGetTimerValue();
@@ -1127,6 +2466,8 @@ int main (int argc, char** argv) {
 		}
 	}
 	
+	render_thread.stop();
+	
 	glfwDestroyWindow(wnd);
 	glfwTerminate();
 	
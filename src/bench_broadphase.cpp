@@ -0,0 +1,202 @@
+
+// benchmark of the broad phase options (brute force, Spatial_Grid, LBVH) across entity distributions
+//  build like the game: 'build.bat vs release bench_broadphase'
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+#include "lang_helpers.hpp"
+#include "math.hpp"
+#include "vector/vector.hpp"
+#include "random.hpp"
+#include "parallel.hpp"
+
+typedef s32v2	iv2;
+typedef fv2		v2;
+
+#include "spatial.hpp"
+#include "lbvh.hpp"
+
+static f64 get_time () {
+	return std::chrono::duration<f64>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+constexpr f32	AREA_PER_ENTITY =	64;
+constexpr f32	RADII[3] =			{ 1.2f, 3.6f, 6 }; // asteroid extents per size
+constexpr f32	MAX_RADIUS =		6;
+
+static Spatial_Grid	grid;
+static LBVH			bvh;
+
+static dynarr<v2>	pos;
+static dynarr<f32>	radius;
+static dynarr<v2>	bullets;
+
+enum distribution_e : u32 {
+	UNIFORM		=0,
+	CLUSTERS	,
+	ONE_CLUSTER	, // after a big split cascade
+	DISTRIBUTION_COUNT
+};
+static cstr distribution_names[] = { "uniform", "clusters", "one cluster" };
+
+static v2 random_in_disc (v2 center, f32 r, v2 world_radius) {
+	v2 p;
+	do { p = random::v2_n1p1(); } while (dot(p,p) > 1);
+	p = center +p*r;
+	return mymod(p +world_radius, world_radius*2) -world_radius;
+}
+
+static void generate (distribution_e dist, u32 n, v2 world_radius) {
+	pos.realloc(n);
+	radius.realloc(n);
+	bullets.realloc(MAX(n / 4, 1u));
+	
+	v2 clusters[8];
+	for (auto& c : clusters) c = random::v2_n1p1() * world_radius;
+	f32 cluster_r = MIN(world_radius.x, world_radius.y) * 0.15f;
+	
+	for (u32 i=0; i<n; ++i) {
+		switch (dist) {
+			case UNIFORM:		pos[i] = random::v2_n1p1() * world_radius;	break;
+			case CLUSTERS:		pos[i] = random_in_disc(clusters[i % arrlen(clusters)], cluster_r, world_radius);	break;
+			case ONE_CLUSTER:	pos[i] = random_in_disc(clusters[0], cluster_r, world_radius);	break;
+			default: dbg_assert(false);
+		}
+		radius[i] = RADII[ rand() % 3 ];
+	}
+	// bullets are shot at the asteroids, so they follow the same distribution
+	for (u32 i=0; i<bullets.len; ++i) {
+		bullets[i] = random_in_disc(pos[ rand() % n ], MAX_RADIUS*2, world_radius);
+	}
+}
+
+struct Result {
+	f64		ms; // < 0 if skipped
+	u64		hits;
+};
+
+static bool bullet_hits (u32 e, v2 delta) {
+	return dot(delta,delta) <= radius[e]*radius[e];
+}
+static bool pair_hits (u32 a, u32 b, v2 delta) {
+	f32 r = radius[a] +radius[b];
+	return dot(delta,delta) <= r*r;
+}
+
+template <typename FUNC> static Result measure (FUNC f) {
+	f64 t0 = get_time();
+	u64 hits = f();
+	return { (get_time() -t0) * 1000, hits };
+}
+
+static Result bullets_brute (v2 world_radius) {
+	if ((u64)pos.len * bullets.len > 200000000ull) return { -1, 0 };
+	return measure([&] () {
+		u64 hits = 0;
+		for (v2 b : bullets) {
+			for (u32 e=0; e<pos.len; ++e) {
+				hits += bullet_hits(e, torus_delta(b, pos[e], world_radius));
+			}
+		}
+		return hits;
+	});
+}
+static Result bullets_grid (v2 world_radius) {
+	return measure([&] () {
+		grid.build(pos, world_radius, MAX_RADIUS*2);
+		u64 hits = 0;
+		for (v2 b : bullets) {
+			grid.query_radius(b, MAX_RADIUS, [&] (u32 e, v2 delta) { hits += bullet_hits(e, delta); });
+		}
+		return hits;
+	});
+}
+static Result bullets_lbvh (v2 world_radius) {
+	return measure([&] () {
+		bvh.build(pos.len, [] (u32 i) { return pos[i]; }, [] (u32 i) { return radius[i]; }, world_radius);
+		u64 hits = 0;
+		for (v2 b : bullets) {
+			bvh.query(b, 0, [&] (u32 e, v2 delta) { hits += bullet_hits(e, delta); });
+		}
+		return hits;
+	});
+}
+
+static Result pairs_brute (v2 world_radius) {
+	if ((u64)pos.len * pos.len > 400000000ull) return { -1, 0 };
+	return measure([&] () {
+		u64 hits = 0;
+		for (u32 a=0; a<pos.len; ++a) {
+			for (u32 b=a+1; b<pos.len; ++b) {
+				hits += pair_hits(a, b, torus_delta(pos[a], pos[b], world_radius));
+			}
+		}
+		return hits;
+	});
+}
+static Result pairs_grid (v2 world_radius) {
+	return measure([&] () {
+		grid.build(pos, world_radius, MAX_RADIUS*2);
+		u64 hits = 0;
+		for (u32 a=0; a<pos.len; ++a) {
+			grid.query_radius(pos[a], radius[a] +MAX_RADIUS, [&] (u32 b, v2 delta) {
+				if (b > a) hits += pair_hits(a, b, delta);
+			});
+		}
+		return hits;
+	});
+}
+static Result pairs_lbvh (v2 world_radius) {
+	return measure([&] () {
+		bvh.build(pos.len, [] (u32 i) { return pos[i]; }, [] (u32 i) { return radius[i]; }, world_radius);
+		u64 hits = 0;
+		bvh.query_pairs([&] (u32 a, u32 b, v2 delta) { hits += pair_hits(a, b, delta); });
+		return hits;
+	});
+}
+
+static void print_row (cstr workload, cstr dist, u32 n, Result brute, Result grid, Result lbvh) {
+	Result results[] = { brute, grid, lbvh };
+	cstr names[] = { "brute", "grid", "lbvh" };
+	
+	u32 winner = 1;
+	bool agree = true;
+	for (u32 i=0; i<3; ++i) {
+		if (results[i].ms < 0) continue;
+		if (results[i].ms < results[winner].ms) winner = i;
+		if (results[i].hits != grid.hits) agree = false;
+	}
+	
+	char brute_str[32];
+	if (brute.ms < 0)	snprintf(brute_str, sizeof(brute_str), "%10s", "-");
+	else				snprintf(brute_str, sizeof(brute_str), "%10.3f", brute.ms);
+	
+	printf("%-8s %-12s %8u  %s  %10.3f  %10.3f  %-6s %10llu %s\n", workload, dist, n,
+			brute_str, grid.ms, lbvh.ms, names[winner], grid.hits, agree ? "" : "MISMATCH");
+}
+
+int main (int argc, char** argv) {
+	random::init_same_seed_everytime();
+	
+	printf("%u threads\n", get_thread_count());
+	printf("workload distribution  entities       brute        grid        lbvh  winner       hits  (ms, build included)\n");
+	
+	for (u32 d=0; d<DISTRIBUTION_COUNT; ++d) {
+		for (u32 n : { 100u, 1000u, 10000u, 100000u, 1000000u }) {
+			f32 area = (f32)n * AREA_PER_ENTITY;
+			v2 world_radius = v2(sqrt(area * 1.6f), sqrt(area / 1.6f)) / 2;
+			
+			generate((distribution_e)d, n, world_radius);
+			
+			print_row("bullets", distribution_names[d], n,
+					bullets_brute(world_radius), bullets_grid(world_radius), bullets_lbvh(world_radius));
+			print_row("pairs", distribution_names[d], n,
+					pairs_brute(world_radius), pairs_grid(world_radius), pairs_lbvh(world_radius));
+		}
+	}
+	
+	return 0;
+}
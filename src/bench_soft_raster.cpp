@@ -0,0 +1,175 @@
+
+// benchmark of the software rasterizer (Soft_Raster), fill rate and a game-like frame at a few resolutions
+//  also dumps that frame to soft_raster_scene.bmp, so this doubles as a headless render check
+//  build like the game: 'build.bat vs release bench_soft_raster'
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+#include "lang_helpers.hpp"
+#include "math.hpp"
+#include "vector/vector.hpp"
+#include "random.hpp"
+#include "parallel.hpp"
+
+typedef s32v2	iv2;
+typedef fv2		v2;
+typedef fv3		v3;
+typedef fv4		v4;
+typedef fm4		m4;
+
+#include "soft_raster.hpp"
+
+static f64 get_time () {
+	return std::chrono::duration<f64>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+typedef Soft_Raster::Vertex Vertex;
+
+static Soft_Raster			raster;
+
+static dynarr<Vertex>		world_tris;
+static dynarr<Vertex>		asteroid_lines;
+static dynarr<Vertex>		bullet_points;
+static dynarr<Vertex>		ship_lines;
+static dynarr<Vertex>		text_tris;
+static dynarr<u8>			glyph_atlas;
+
+constexpr v2	WORLD_RADIUS =		v2(80, 50);
+constexpr u32	ASTEROIDS =			2000;
+constexpr u32	BULLETS =			500;
+constexpr u32	TEXT_CHARS =		1500; // a few lines of debug text
+constexpr u32	ATLAS_SIZE =		128;
+
+static void quad (dynarr<Vertex>* out, v2 a, v2 b, v2 uv_a, v2 uv_b, v4 col) {
+	v2 pos[6] = { v2(a.x,a.y), v2(b.x,a.y), v2(b.x,b.y),  v2(b.x,b.y), v2(a.x,b.y), v2(a.x,a.y) };
+	v2 uv[6] = { v2(uv_a.x,uv_a.y), v2(uv_b.x,uv_a.y), v2(uv_b.x,uv_b.y),  v2(uv_b.x,uv_b.y), v2(uv_a.x,uv_b.y), v2(uv_a.x,uv_a.y) };
+	u32 i = out->pushn(6);
+	for (u32 j=0; j<6; ++j) (*out)[i +j] = { pos[j], uv[j], col };
+}
+
+// roughly what the game draws: world background, asteroid outlines, bullets, the ship and debug text
+static void generate_scene () {
+	quad(&world_tris, -WORLD_RADIUS, WORLD_RADIUS, 0, 0, v4(v3(0.01f), 1));
+	
+	for (u32 i=0; i<ASTEROIDS; ++i) {
+		v2 center = random::v2_n1p1() * WORLD_RADIUS;
+		f32 r = lerp(0.5f, 3.0f, random::f32_01());
+		constexpr u32 VERTS = 12;
+		
+		u32 j = asteroid_lines.pushn(VERTS*2);
+		for (u32 k=0; k<VERTS; ++k) {
+			auto vert = [&] (u32 k) { f32 a = (f32)k / VERTS * deg(360); return center +rotate2(a) * v2(r, 0); };
+			asteroid_lines[j +k*2 +0] = { vert(k), 0, v4(1) };
+			asteroid_lines[j +k*2 +1] = { vert((k +1) % VERTS), 0, v4(1) };
+		}
+	}
+	for (u32 i=0; i<BULLETS; ++i) {
+		bullet_points.push({ random::v2_n1p1() * WORLD_RADIUS, 0, v4(1, 0.2f, 0.2f, 1) });
+	}
+	v2 ship[] = { v2(0,1.5f), v2(1,-1), v2(1,-1), v2(-1,-1), v2(-1,-1), v2(0,1.5f) };
+	for (v2 p : ship) ship_lines.push({ p, 0, v4(0.5f, 1, 0.5f, 1) });
+	
+	// blocky fake glyphs, enough to have a realistic mix of covered and empty texels
+	glyph_atlas.realloc(ATLAS_SIZE*ATLAS_SIZE);
+	for (u32 y=0; y<ATLAS_SIZE; ++y) {
+		for (u32 x=0; x<ATLAS_SIZE; ++x) {
+			glyph_atlas[y*ATLAS_SIZE +x] = (rand() % 3) == 0 ? 255 : 0;
+		}
+	}
+	constexpr u32 CHARS_PER_LINE = 150;
+	constexpr v2 CHAR_SIZE = v2(8, 16) / v2(1280, 720) * 2; // in clip space, at 1280x720
+	for (u32 i=0; i<TEXT_CHARS; ++i) {
+		v2 a = v2(-1, 1) +v2((f32)(i % CHARS_PER_LINE), -(f32)(i / CHARS_PER_LINE +1)) * CHAR_SIZE;
+		v2 uv_a = v2((f32)(rand() % 16), (f32)(rand() % 8)) * v2(1.0f/16, 1.0f/8);
+		quad(&text_tris, a, a +CHAR_SIZE, uv_a, uv_a +v2(1.0f/16, 1.0f/8), v4(1,1,1, 0.9f));
+	}
+}
+
+static void draw_scene (v2 target_dim) {
+	v2 view_radius = v2(WORLD_RADIUS.y * target_dim.x / target_dim.y, WORLD_RADIUS.y) * 1.05f;
+	m4 world_to_clip = scale4(v3(1 / view_radius, 1));
+	
+	raster.clear(v4(v3(0.03f), 1));
+	raster.draw(Soft_Raster::TRIANGLES, world_tris, world_to_clip);
+	raster.draw(Soft_Raster::LINES, asteroid_lines, world_to_clip);
+	raster.draw(Soft_Raster::POINTS, bullet_points, world_to_clip, {}, 5);
+	raster.draw(Soft_Raster::LINES, ship_lines, world_to_clip);
+	raster.draw(Soft_Raster::TRIANGLES, text_tris, m4::ident(), { glyph_atlas.arr, ATLAS_SIZE, ATLAS_SIZE });
+	raster.flush();
+}
+
+// best of runs, in ms
+template <typename FUNC> static f64 measure (u32 runs, FUNC f) {
+	f64 best = BUILTIN_F64_INF;
+	for (u32 i=0; i<runs; ++i) {
+		f64 t0 = get_time();
+		f();
+		best = MIN(best, get_time() -t0);
+	}
+	return best * 1000;
+}
+
+static void bench_fill_rate () {
+	constexpr u32 W = 1920, H = 1080;
+	constexpr u32 LAYERS = 10;
+	
+	printf("fill rate, %d full screen quads at %dx%d (Mpix/s)\n", LAYERS, W, H);
+	printf("threads      opaque     blended    textured\n");
+	
+	static dynarr<Vertex> opaque, blended, textured;
+	for (u32 i=0; i<LAYERS; ++i) {
+		quad(&opaque,	-1, 1, 0, 0, v4((f32)i / LAYERS, 0.5f, 0.2f, 1));
+		quad(&blended,	-1, 1, 0, 0, v4((f32)i / LAYERS, 0.5f, 0.2f, 0.5f));
+		quad(&textured,	-1, 1, 0, 8, v4(1));
+	}
+	
+	for (u32 threads : { 1u, get_thread_count() }) {
+		raster.init(W, H, threads);
+		
+		auto mpix_per_sec = [&] (dynarr<Vertex> cr quads, Soft_Raster::Texture tex) {
+			f64 ms = measure(5, [&] () {
+				raster.draw(Soft_Raster::TRIANGLES, quads, m4::ident(), tex);
+				raster.flush();
+			});
+			return (f64)raster.pixels_written / (ms / 1000) / 1e6;
+		};
+		f64 o = mpix_per_sec(opaque, {});
+		f64 b = mpix_per_sec(blended, {});
+		f64 t = mpix_per_sec(textured, { glyph_atlas.arr, ATLAS_SIZE, ATLAS_SIZE });
+		
+		printf("%7u  %10.1f  %10.1f  %10.1f\n", threads, o, b, t);
+	}
+}
+
+static void bench_scene () {
+	printf("\ngame-like frame (%u asteroids, %u bullets, %u chars of text), best of 10\n", ASTEROIDS, BULLETS, TEXT_CHARS);
+	printf("resolution   threads         ms        fps\n");
+	
+	struct { u32 w, h; } resolutions[] = { {1280,720}, {1920,1080}, {3840,2160} };
+	for (auto r : resolutions) {
+		for (u32 threads : { 1u, get_thread_count() }) {
+			raster.init(r.w, r.h, threads);
+			f64 ms = measure(10, [&] () { draw_scene(v2((f32)r.w, (f32)r.h)); });
+			printf("%4ux%-4u  %9u  %9.3f  %9.1f\n", r.w, r.h, threads, ms, 1000 / ms);
+		}
+	}
+	
+	raster.init(1280, 720);
+	draw_scene(v2(1280, 720));
+	if (raster.dump("soft_raster_scene.bmp"))	printf("\nwrote soft_raster_scene.bmp\n");
+	else										printf("\ncould not write soft_raster_scene.bmp\n");
+}
+
+int main (int argc, char** argv) {
+	random::init_same_seed_everytime();
+	
+	generate_scene();
+	
+	bench_fill_rate();
+	bench_scene();
+	
+	return 0;
+}
@@ -0,0 +1,188 @@
+
+// benchmark of the Spatial_Grid queries against a linear scan
+//  build like the game: 'build.bat vs release bench_spatial'
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+#include "lang_helpers.hpp"
+#include "math.hpp"
+#include "vector/vector.hpp"
+#include "random.hpp"
+#include "arena.hpp"
+#include "parallel.hpp"
+
+typedef s32v2	iv2;
+typedef fv2		v2;
+
+#include "spatial.hpp"
+
+static f64 get_time () {
+	return std::chrono::duration<f64>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+static Spatial_Grid grid;
+
+static volatile u32 sink; // so the queries can't be optimized away
+
+// average time per query in microseconds
+template <typename FUNC> static f64 bench (array<v2> cr queries, u32 count, FUNC query) {
+	f64 t0 = get_time();
+	for (u32 i=0; i<count; ++i) query(queries[i]);
+	return (get_time() -t0) / count * 1e6;
+}
+
+constexpr f32	AREA_PER_ENTITY =	16; // roughly as dense as a field of medium asteroids
+
+static v2 get_world_radius (u32 entity_count) {
+	f32 area = (f32)entity_count * AREA_PER_ENTITY;
+	return v2(sqrt(area * 1.6f), sqrt(area / 1.6f)) / 2;
+}
+
+static void bench_queries () {
+	constexpr u32	QUERIES =			10000;
+	constexpr f32	RADIUS =			8;
+	
+	printf("entities        build      knn k=1      knn k=8   radius r=%.0f  linear k=1  (per query, us)  knn errors\n", RADIUS);
+	
+	for (u32 n : { 100u, 1000u, 10000u, 100000u, 1000000u }) {
+		v2 world_radius = get_world_radius(n);
+		
+		auto positions = array<v2>::malloc(n);
+		defer { positions.free(); };
+		for (auto& p : positions) p = random::v2_n1p1() * world_radius;
+		
+		auto queries = array<v2>::malloc(QUERIES);
+		defer { queries.free(); };
+		for (auto& p : queries) p = random::v2_n1p1() * world_radius;
+		
+		f64 t0 = get_time();
+		grid.build(positions, world_radius, sqrt(AREA_PER_ENTITY * 2)); // ~2 entities per cell
+		f64 t_build = get_time() -t0;
+		
+		f64 t_knn1 = bench(queries, QUERIES, [&] (v2 p) {
+			u32 indx;
+			sink += grid.query_knn(p, 1, &indx);
+		});
+		f64 t_knn8 = bench(queries, QUERIES, [&] (v2 p) {
+			u32 indx[8];
+			sink += grid.query_knn(p, 8, indx);
+		});
+		f64 t_radius = bench(queries, QUERIES, [&] (v2 p) {
+			u32 count = 0;
+			grid.query_radius(p, RADIUS, [&] (u32 indx, v2 delta) { ++count; });
+			sink += count;
+		});
+		
+		auto linear_nearest = [&] (v2 p, f32* out_dist_sqr) {
+			u32 nearest = 0;
+			f32 nearest_dist_sqr = BUILTIN_F32_INF;
+			for (u32 i=0; i<positions.len; ++i) {
+				v2 d = torus_delta(p, positions[i], world_radius);
+				if (dot(d,d) < nearest_dist_sqr) {
+					nearest_dist_sqr = dot(d,d);
+					nearest = i;
+				}
+			}
+			*out_dist_sqr = nearest_dist_sqr;
+			return nearest;
+		};
+		
+		u32 linear_queries = MIN(QUERIES, 100000000u / n); // linear scan gets too slow for big n
+		f64 t_linear = bench(queries, linear_queries, [&] (v2 p) {
+			f32 dist_sqr;
+			sink += linear_nearest(p, &dist_sqr);
+		});
+		
+		// the grid has to find the same nearest distance as the linear scan
+		u32 errors = 0;
+		for (u32 i=0; i<linear_queries; ++i) {
+			u32 indx;
+			f32 dist_sqr, linear_dist_sqr;
+			grid.query_knn(queries[i], 1, &indx, &dist_sqr);
+			linear_nearest(queries[i], &linear_dist_sqr);
+			if (dist_sqr != linear_dist_sqr) ++errors;
+		}
+		
+		printf("%8u  %8.3f ms  %8.3f us  %8.3f us  %8.3f us  %9.3f us  %12u\n",
+				n, t_build*1000, t_knn1, t_knn8, t_radius, t_linear, errors);
+	}
+}
+
+struct Bench_Entity { // same footprint as an asteroid
+	v2	pos;
+	v2	vel;
+	u32	size;
+	v2	vertecies[12];
+};
+static Arena				entity_arena;
+static dynarr<Bench_Entity*>	entities;
+
+// collision phase like in the game (grid build + radius query per bullet that reads the mesh of every candidate)
+//  before and after reorder_by_morton
+static void bench_morton_reorder () {
+	constexpr f32	MAX_EXTENT =		6;
+	constexpr u32	RUNS =				5;
+	
+	printf("\ncollision phase, entities in scrambled vs morton order (best of %d, ms)\n", RUNS);
+	printf("entities   bullets   scrambled      morton   speedup\n");
+	
+	for (u32 n : { 1000u, 10000u, 100000u, 1000000u }) {
+		v2 world_radius = get_world_radius(n);
+		
+		// allocation order == array order, both unrelated to position, like after many splits
+		entity_arena.reset();
+		Arena_Pool<Bench_Entity> pool = { &entity_arena };
+		
+		entities.realloc(n);
+		for (auto& e : entities) {
+			e = pool.alloc();
+			e->pos = random::v2_n1p1() * world_radius;
+			for (auto& v : e->vertecies) v = random::v2_n1p1() * MAX_EXTENT;
+		}
+		
+		u32 bullet_count = n / 4;
+		auto bullets = array<v2>::malloc(bullet_count);
+		defer { bullets.free(); };
+		for (auto& p : bullets) p = random::v2_n1p1() * world_radius;
+		
+		auto collision_phase = [&] () -> f64 {
+			f64 best = BUILTIN_F64_INF;
+			for (u32 run=0; run<RUNS; ++run) {
+				f64 t0 = get_time();
+				
+				grid.build(n, [&] (u32 i) { return entities[i]->pos; }, world_radius, MAX_EXTENT*2);
+				
+				f32 sum = 0;
+				for (v2 p : bullets) {
+					grid.query_radius(p, MAX_EXTENT, [&] (u32 indx, v2 delta) {
+						for (v2 v : entities[indx]->vertecies) sum += v.x;
+					});
+				}
+				sink += (u32)sum;
+				
+				best = MIN(best, get_time() -t0);
+			}
+			return best * 1000;
+		};
+		
+		f64 t_scrambled = collision_phase();
+		
+		reorder_by_morton(entities, world_radius, [] (Bench_Entity const* e) { return e->pos; });
+		
+		f64 t_morton = collision_phase();
+		
+		printf("%8u  %8u  %10.3f  %10.3f  %7.2fx\n", n, bullet_count, t_scrambled, t_morton, t_scrambled / t_morton);
+	}
+}
+
+int main (int argc, char** argv) {
+	random::init_same_seed_everytime();
+	
+	bench_queries();
+	bench_morton_reorder();
+	
+	return 0;
+}
@@ -4,13 +4,89 @@
 #define STB_TRUETYPE_IMPLEMENTATION
 #include "stb_truetype.h"
 
+#if RZ_PLATF == RZ_PLATF_GENERIC_UNIX
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+// read-only contents of a whole file, mapped if possible, so pages only get read when they are touched and nothing is copied
+//  files that can't be mapped (empty ones for example) get read into memory instead
 struct File_Data {
-	byte*	data;
-	u64		size;
+	byte const*	data; // null if the file could not be read
+	u64			size;
+	bool		mapped;
+	
+	#if RZ_PLATF == RZ_PLATF_GENERIC_WIN
+	HANDLE		file;
+	HANDLE		mapping;
+	#endif
 	
-	void free () { ::free(data); }
+	void free () {
+		if (!data) return;
+		if (!mapped) {
+			::free((void*)data);
+		} else {
+			#if RZ_PLATF == RZ_PLATF_GENERIC_WIN
+			UnmapViewOfFile(data);
+			CloseHandle(mapping);
+			CloseHandle(file);
+			#else
+			munmap((void*)data, size);
+			#endif
+		}
+		data = nullptr;
+		size = 0;
+	}
 };
+static bool map_file (cstr filename, File_Data* out) {
+	File_Data ret = {};
+	ret.mapped = true;
+	
+	#if RZ_PLATF == RZ_PLATF_GENERIC_WIN
+	ret.file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (ret.file == INVALID_HANDLE_VALUE) return false;
+	
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(ret.file, &size) || size.QuadPart == 0) { // empty files can't be mapped
+		CloseHandle(ret.file);
+		return false;
+	}
+	ret.size = (u64)size.QuadPart;
+	
+	ret.mapping = CreateFileMappingA(ret.file, NULL, PAGE_READONLY, 0,0, NULL);
+	if (!ret.mapping) {
+		CloseHandle(ret.file);
+		return false;
+	}
+	ret.data = (byte const*)MapViewOfFile(ret.mapping, FILE_MAP_READ, 0,0, 0);
+	if (!ret.data) {
+		CloseHandle(ret.mapping);
+		CloseHandle(ret.file);
+		return false;
+	}
+	#else
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) return false;
+	defer { close(fd); }; // the mapping stays valid
+	
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) return false;
+	ret.size = (u64)st.st_size;
+	
+	void* data = mmap(nullptr, ret.size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED) return false;
+	ret.data = (byte const*)data;
+	#endif
+	
+	*out = ret;
+	return true;
+}
 static File_Data load_file (cstr filename) {
+	File_Data ret = {};
+	if (map_file(filename, &ret)) return ret;
+	
 	auto f = fopen(filename, "rb");
 	if (!f) return {}; // fail
 	defer { fclose(f); };
@@ -19,13 +95,14 @@ static File_Data load_file (cstr filename) {
 	u64 file_size = ftell(f); // only 32 support for now
 	rewind(f);
 	
-	byte* data = (byte*)malloc(file_size);
+	byte* data = (byte*)malloc(MAX(file_size, (u64)1)); // never null for empty files
 	
-	auto ret = fread(data, 1,file_size, f);
-	dbg_assert(ret == file_size);
-	file_size = ret;
+	auto read = fread(data, 1,file_size, f);
+	dbg_assert(read == file_size);
 	
-	return {data,file_size};
+	ret.data = data;
+	ret.size = read;
+	return ret;
 }
 
 struct Texture {
@@ -34,8 +111,8 @@ struct Texture {
 	u32		w;
 	u32		h;
 	
+	// only the cpu side
 	void alloc (u32 w, u32 h) {
-		glGenTextures(1, &gl);
 		this->w = w;
 		this->h = h;
 		data = (u8*)::malloc(w*h*sizeof(u8));
@@ -125,96 +202,683 @@ namespace font {
 		static int map_char (char c) {
 			return (s32)(c -ASCII_FIRST) +ASCII_INDX;
 		}
-		static int map_char (utf32 u) {
-			if (u >= ASCII_FIRST && u <= ASCII_LAST) {
-				return map_char((char)u);
-			}
-			switch (u) {
-				case DE_CHARS[DE_UU]:		return DE_UU +DE_INDX;
-				case DE_CHARS[DE_AE]:		return DE_AE +DE_INDX;
-				case DE_CHARS[DE_OE]:		return DE_OE +DE_INDX;
-				case DE_CHARS[DE_UE]:		return DE_UE +DE_INDX;
-				case DE_CHARS[DE_ae]:		return DE_ae +DE_INDX;
-				case DE_CHARS[DE_oe]:		return DE_oe +DE_INDX;
-				case DE_CHARS[DE_ue]:		return DE_ue +DE_INDX;
+		// glyph indices below TOTAL_CHARS are the glyphs packed at init, the ones above are cells of the dynamic part of the atlas (Font::get_glyph)
+		static constexpr int GLYPH_NOT_RESIDENT = 0xffff;
+		
+		// codepoint -> glyph index through a two level table, the high bits select a page of 256 glyph indices
+		//  pages without any glyph all share the missing page, so the table only costs memory for the pages that have glyphs
+		//  built from the same definitions as above by init_glyph_table, so more scripts don't make the lookup any slower
+		//  once all pages are taken, the glyphs of further pages go into a hash map (dynamic glyphs can come from all over unicode), which is slower but has no limit
+		static constexpr u32 PAGE_BITS =	8;
+		static constexpr u32 PAGE_SIZE =	1 << PAGE_BITS;
+		static constexpr u32 PAGE_COUNT =	(0x10FFFF >> PAGE_BITS) +1; // all of unicode
+		static constexpr u32 MAX_PAGES =	16; // pages with glyphs +the missing page
+		static constexpr u8 OVERFLOW_PAGE =	0xff; // in page_table, the glyphs of this page are in overflow_glyphs
+		static_assert(MAX_PAGES <= OVERFLOW_PAGE, "");
+		
+		static u8	page_table[PAGE_COUNT]; // index into pages
+		static u16	pages[MAX_PAGES][PAGE_SIZE];
+		static u32	pages_used;
+		
+		// open addressing with linear probing, codepoint 0 marks an empty slot (its page always exists)
+		//  entries never get removed, a glyph that got evicted from its cell stays as GLYPH_NOT_RESIDENT
+		struct Overflow_Glyph {
+			utf32	codepoint;
+			u16		glyph;
+		};
+		static dynarr<Overflow_Glyph>	overflow_glyphs; // power of two length
+		static u32						overflow_used;
+		
+		static u32 overflow_slot (utf32 u) {
+			u32 mask = overflow_glyphs.len -1;
+			u32 i = (u * 2654435761u) & mask; // multiplicative hash, the length is a power of two, so neighbouring codepoints still land in different slots
+			while (overflow_glyphs[i].codepoint && overflow_glyphs[i].codepoint != u) i = (i +1) & mask;
+			return i;
+		}
+		static void set_overflow_glyph (utf32 u, int glyph) {
+			if ((overflow_used +1) * 2 > overflow_glyphs.len) { // keep it at most half full
+				auto old = overflow_glyphs;
+				overflow_glyphs = {};
+				overflow_glyphs.realloc(MAX(old.len * 2, (u32)64));
+				memset(overflow_glyphs.arr, 0, overflow_glyphs.len * sizeof(Overflow_Glyph));
 				
-				case JP_CHARS[JP_SPACE			]:	return JP_SPACE			+JP_INDX;
-				case JP_CHARS[JP_COMMA			]:	return JP_COMMA			+JP_INDX;
-				case JP_CHARS[JP_PEROID			]:	return JP_PEROID		+JP_INDX;
-				case JP_CHARS[JP_SEP_DOT		]:	return JP_SEP_DOT		+JP_INDX;
-				case JP_CHARS[JP_DASH			]:	return JP_DASH			+JP_INDX;
-				case JP_CHARS[JP_UNDERSCORE		]:	return JP_UNDERSCORE	+JP_INDX;
-				case JP_CHARS[JP_BRACKET_OPEN	]:	return JP_BRACKET_OPEN	+JP_INDX;
-				case JP_CHARS[JP_BRACKET_CLOSE	]:	return JP_BRACKET_CLOSE	+JP_INDX;
+				for (auto& e : old) if (e.codepoint) overflow_glyphs[overflow_slot(e.codepoint)] = e;
+				old.free();
+			}
+			
+			auto& e = overflow_glyphs[overflow_slot(u)];
+			if (!e.codepoint) {
+				e.codepoint = u;
+				++overflow_used;
+			}
+			e.glyph = (u16)glyph;
+		}
+		static int get_overflow_glyph (utf32 u) {
+			auto& e = overflow_glyphs[overflow_slot(u)];
+			return e.codepoint ? e.glyph : GLYPH_NOT_RESIDENT;
+		}
+		
+		static void set_glyph (utf32 u, int glyph) {
+			u32 page = u >> PAGE_BITS;
+			if (page_table[page] == 0) {
+				if (glyph == GLYPH_NOT_RESIDENT) return; // the missing page already says that
 				
+				if (pages_used < MAX_PAGES) {
+					page_table[page] = (u8)pages_used;
+					for (u32 i=0; i<PAGE_SIZE; ++i) pages[pages_used][i] = pages[0][i];
+					++pages_used;
+				} else {
+					page_table[page] = OVERFLOW_PAGE;
+				}
 			}
-			if (u >= JP_HG_FIRST && u <= JP_HG_LAST) {
-				return (s32)(u -JP_HG_FIRST) +JP_HG_INDX;
+			if (page_table[page] == OVERFLOW_PAGE) {
+				set_overflow_glyph(u, glyph);
+				return;
 			}
+			pages[ page_table[page] ][ u & (PAGE_SIZE -1) ] = (u16)glyph;
+		}
+		
+		static void init_glyph_table () {
+			// page 0 is the missing page
+			for (u32 i=0; i<PAGE_SIZE; ++i) pages[0][i] = GLYPH_NOT_RESIDENT;
+			for (auto& p : page_table) p = 0;
+			pages_used = 1;
+			
+			overflow_glyphs.realloc(0);
+			overflow_used = 0;
 			
-			dbg_assert(false, "Char '%c' [%x] missing in font", u, u);
-			return map_char('!'); // missing char
+			for (utf32 u=ASCII_FIRST; u<=ASCII_LAST; ++u)	set_glyph(u, map_char((char)u));
+			for (u32 i=0; i<DE_NUM; ++i)					set_glyph(DE_CHARS[i], DE_INDX +i);
+			for (u32 i=0; i<JP_NUM; ++i)					set_glyph(JP_CHARS[i], JP_INDX +i);
+			for (utf32 u=JP_HG_FIRST; u<=JP_HG_LAST; ++u)	set_glyph(u, (s32)(u -JP_HG_FIRST) +JP_HG_INDX);
+		}
+		
+		// inverse of the packed part of the table, the jp glyphs come from the second font
+		static utf32 packed_codepoint (int glyph, u32* font) {
+			*font = glyph < JP_INDX ? 0 : 1;
+			if (glyph < DE_INDX)		return (utf32)(glyph -ASCII_INDX) +ASCII_FIRST;
+			if (glyph < JP_INDX)		return DE_CHARS[glyph -DE_INDX];
+			if (glyph < JP_HG_INDX)		return JP_CHARS[glyph -JP_INDX];
+			return (utf32)(glyph -JP_HG_INDX) +JP_HG_FIRST;
+		}
+		
+		// GLYPH_NOT_RESIDENT for codepoints that are not in the atlas (yet)
+		static int map_char (utf32 u) {
+			u = MIN(u, (utf32)0x10FFFF);
+			u8 page = page_table[u >> PAGE_BITS];
+			if (page == OVERFLOW_PAGE) return get_overflow_glyph(u);
+			return pages[page][ u & (PAGE_SIZE -1) ];
 		}
 	}
 	using namespace mapping;
 	
+	typedef VBO_Pos_Tex_Col::V Text_Vertex;
+	
+	// a laid out line of text, keyed by everything that goes into its vertecies (text, position, color, size and window size, since the vertecies are in clip space)
+	//  stays in the resident text buffer for as long as it gets drawn every frame
+	struct Text_Layout {
+		bool				alive;
+		
+		u64					hash;
+		dynarr<utf8>		text; // without null terminator
+		v2					pos_screen;
+		rgba8				col;
+		iv2					wnd_dim;
+		f32					size;
+		
+		dynarr<Text_Vertex>	verts; // kept for draw_soft and for when the line has to move in the resident buffer
+		u32					first; // in the resident text buffer
+		u32					capacity; // vertecies reserved there, 0 if it still has to be uploaded
+		
+		struct Cell_Ref {
+			u32	cell;
+			u32	generation;
+		};
+		dynarr<Cell_Ref>	cells; // dynamic glyphs the vertecies refer to, the line has to be laid out again if one of them got evicted
+	};
+	
+	// FNV-1a
+	static u64 hash_bytes (void const* data, uptr size, u64 h=14695981039346656037ull) {
+		for (uptr i=0; i<size; ++i) {
+			h ^= ((u8 const*)data)[i];
+			h *= 1099511628211ull;
+		}
+		return h;
+	}
+	
+	// the packed atlas gets baked into a file on the first launch and is loaded from it after that
+	//  file: Atlas_Blob_Header, stbtt_packedchar[char_count], u8 pixels[tex_w*tex_h] (already flipped)
+	//  rebaked when the font files, sizes, glyph set or sdf parameters change (not when the contents of the font files change, delete the file for that)
+	//  changes to how the atlas gets packed or rendered are not part of the key, bump ATLAS_BLOB_VERSION for those
+	struct Atlas_Blob_Header {
+		u32		magic;
+		u32		version;
+		u64		key; // of everything that went into the atlas
+		u32		tex_w;
+		u32		tex_h;
+		u32		char_count;
+		u32		pad;
+	};
+	static constexpr u32	ATLAS_BLOB_MAGIC =		0x534c5441; // "ATLS"
+	static constexpr u32	ATLAS_BLOB_VERSION =	1;
+	
+	static constexpr cstr	JP_FONT_FILEPATH =		"c:/windows/fonts/meiryo.ttc"; // always use meiryo for now
+	
+	// has to start out zeroed (static)
 	struct Font {
+		// atlas, rows [0, cell_rows*cell_size) are the dynamic cells, the packed glyphs are after that (flipped, like all of the atlas)
 		Texture					tex;
-		VBO_Pos_Tex_Col			vbo;
+		bool					atlas_baked; // this launch, because there was no up to date blob
+		f32						packed_occupancy; // of the packed part of the atlas, the rest is empty padding
+		
+		static constexpr u32	MAX_ATLAS_SIZE =		4096;
+		
+		// distance field atlas, the glyphs are generated once at SDF_SIZE and scaled to whatever size they are drawn at (Shader_Clip_Tex_Col_Sdf)
+		//  otherwise the atlas is coverage at exactly the font size
+		bool					sdf;
+		f32						size; // default text size in pixels
+		
+		static constexpr f32	SDF_SIZE =				24;
+		static constexpr s32	SDF_PADDING =			4; // texels of distance around every glyph
+		static constexpr u8		SDF_ONEDGE =			128;
+		static constexpr f32	SDF_PIXEL_DIST_SCALE =	(f32)SDF_ONEDGE / SDF_PADDING; // value per texel of distance, so the padding covers the whole range
 		
 		stbtt_packedchar		chars[TOTAL_CHARS];
 		
-		bool init (cstr filepath, u32 fontsize=16) {
+		// dynamic glyphs, every codepoint that was not packed gets rasterized into a cell the first time it is drawn
+		//  the least recently used cell gets reused once all are taken, so any amount of different glyphs works with a fixed texture size
+		static constexpr u32	DYNAMIC_CELLS =			256; // at least
+		static constexpr u32	DYNAMIC_ATLAS_WIDTH =	1024; // at least
+		
+		struct Cell {
+			utf32				codepoint; // 0 if free
+			u32					last_used; // frame
+			u32					generation; // counts the glyphs this cell had, so layouts can tell that theirs is gone
+		};
+		u32						cell_size; // in pixels, big enough for the glyphs of both fonts
+		u32						cells_per_row;
+		u32						cell_rows;
+		dynarr<Cell>			cells;
+		dynarr<stbtt_packedchar>	cell_chars; // like chars, in atlas coordinates
+		u32						frame; // counts records, starts at 1
+		
+		struct Glyph_Upload {
+			u32					cell;
+			u32					first; // in upload_pixels
+			u32					w, h; // rect at the origin of the cell
+		};
+		dynarr<Glyph_Upload>	glyph_uploads; // since the last record
+		dynarr<u8>				upload_pixels;
+		
+		// the fonts only get mapped once the first glyph has to be rasterized, the packed glyphs usually come from the blob
+		cstr					font_filepaths[2];
+		f32						font_sizes[2];
+		File_Data				font_files[2];
+		stbtt_fontinfo			font_infos[2];
+		bool					fonts_mapped;
+		
+		u32						glyphs_rasterized; // since the last record
+		u32						glyphs_rasterized_last_frame;
+		
+		// simulation
+		//  lines that are drawn with the same text, position and color as in the last frame reuse their vertecies, which are still in the resident buffer
+		static constexpr u32	ALLOC_GRANULARITY = 16*6; // vertecies, so a line whose numbers change mostly fits into the space of its last version
+		
+		dynarr<Text_Layout>		layouts; // dead ones get reused, only grows when more different lines are drawn in a frame than ever before
+		dynarr<u32>				drawn; // layouts drawn since the last record, in order
+		
+		struct Range {
+			u32	first;
+			u32	count;
+		};
+		u32						resident_used; // bump allocation in the resident buffer
+		u32						resident_live; // reserved by alive layouts
+		dynarr<Range>			resident_free; // reserved by layouts that died
+		
+		u32						rebuilds; // lines laid out since the last record
+		u32						rebuilds_last_frame;
+		u32						lines_last_frame;
+		
+		// render thread
+		GLuint					resident_vbo;
+		GLuint					resident_vao;
+		u32						resident_capacity; // in vertecies
+		
+		// fontsize is only the default size of the text with sdf, the atlas is the same for all sizes
+		bool init (cstr filepath, u32 fontsize=16, bool sdf=false) {
+			load(filepath, fontsize, sdf);
+			init_gl();
+			return true;
+		}
+		
+		// the cpu side of init (glyph table and atlas), does not need the gl context, so it can run on another thread while the window gets created
+		void load (cstr filepath, u32 fontsize=16, bool sdf=false) {
 			
-			vbo.init();
+			init_glyph_table();
 			
-			auto f = load_file(filepath);
-			defer { f.free(); };
+			this->sdf = sdf;
+			size = (f32)fontsize;
 			
-			auto jp_f = load_file("c:/windows/fonts/meiryo.ttc"); // always use meiryo for now
-			defer { jp_f.free(); };
+			f32 sz = sdf ? SDF_SIZE : (f32)fontsize;
+			font_filepaths[0] = filepath;
+			font_filepaths[1] = JP_FONT_FILEPATH;
+			font_sizes[0] = sz;
+			font_sizes[1] = round(sz * 1.5f); // meiryo looks smaller at the same pixel height
 			
-			bool big = 0;
+			char blob_filepath[64];
+			if (sdf)	snprintf(blob_filepath, sizeof(blob_filepath), "font_atlas_sdf.bin");
+			else		snprintf(blob_filepath, sizeof(blob_filepath), "font_atlas_%u.bin", fontsize);
 			
-			u32 texw, texh;
-			f32 sz, jpsz;
-			switch (fontsize) {
-				case 16:	sz=16; jpsz=24;	texw=256;texh=128+16;	break;
-				case 42:	sz=42; jpsz=64;	texw=512;texh=512-128;	break;
-				default: dbg_assert(false, "not implemented"); texw=0; texh=0; sz=0; jpsz=0;
+			u64 key = hash_bytes(filepath, strlen(filepath));
+			key = hash_bytes(JP_FONT_FILEPATH, strlen(JP_FONT_FILEPATH), key);
+			key = hash_bytes(&sdf, sizeof(sdf), key);
+			key = hash_bytes(font_sizes, sizeof(font_sizes), key);
+			{ // the glyph set, a changed entry would otherwise load glyphs for the old codepoints
+				utf32 ranges[] = { ASCII_FIRST, ASCII_LAST, JP_HG_FIRST, JP_HG_LAST };
+				key = hash_bytes(ranges, sizeof(ranges), key);
+				key = hash_bytes(DE_CHARS, sizeof(DE_CHARS), key);
+				key = hash_bytes(JP_CHARS, sizeof(JP_CHARS), key);
+			}
+			if (sdf) {
+				f32 params[] = { (f32)SDF_PADDING, (f32)SDF_ONEDGE, SDF_PIXEL_DIST_SCALE };
+				key = hash_bytes(params, sizeof(params), key);
 			}
-			tex.alloc(texw, texh);
 			
-			stbtt_pack_context spc;
-			stbtt_PackBegin(&spc, tex.data, (s32)tex.w,(s32)tex.h, (s32)tex.w, 1, nullptr);
+			Texture packed = {};
+			File_Data blob = {};
 			
-			//stbtt_PackSetOversampling(&spc, 1,1);
+			atlas_baked = !load_atlas_blob(blob_filepath, key, &blob, &packed);
+			if (atlas_baked) {
+				if (sdf)	pack_atlas_sdf(&packed);
+				else		pack_atlas(&packed);
+				if (!save_atlas_blob(blob_filepath, key, packed)) fprintf(stderr, "could not write %s\n", blob_filepath);
+			}
+			
+			packed_occupancy = get_occupancy(packed);
+			init_atlas(packed);
+			
+			if (atlas_baked)	::free(packed.data);
+			else				blob.free();
+		}
+		// the gl side of init, after load
+		void init_gl () {
+			init_resident_buffer();
+			
+			glGenTextures(1, &tex.gl);
+			glBindTexture(GL_TEXTURE_2D, tex.gl);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, tex.w,tex.h, 0, GL_RED, GL_UNSIGNED_BYTE, tex.data);
+			
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL,	0);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,	0);
+			// distance fields get drawn at any size, so they need filtering, coverage glyphs are snapped to whole pixels and drawn 1:1
+			GLint filter = sdf ? GL_LINEAR : GL_NEAREST;
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,	filter);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,	filter);
+		}
+		
+		// smallest atlas the rects fit into, every power of two width gets tried and the one with the least area wins (the height is tight, not a power of two)
+		//  padding is the gutter on the right and bottom edge, like stbtt_PackBegin, the rects come back packed
+		static bool pack_rects_minimal (stbrp_rect* rects, u32 count, u32 padding, u32* out_w, u32* out_h) {
+			u32 max_w = 0, max_h = 0;
+			for (u32 i=0; i<count; ++i) {
+				max_w = MAX(max_w, (u32)rects[i].w);
+				max_h = MAX(max_h, (u32)rects[i].h);
+			}
+			
+			static dynarr<stbrp_rect> trial; // static so they start out zeroed
+			static dynarr<stbrp_node> nodes;
+			trial.realloc(count);
+			
+			u32 best_w = 0, best_h = 0;
+			for (u32 w=64; w<=MAX_ATLAS_SIZE; w*=2) {
+				if (w < max_w +padding) continue;
+				if (best_w && (u64)w*max_h >= (u64)best_w*best_h) break; // wider can only be worse from here on
+				
+				memcpy(trial.arr, rects, count * sizeof(stbrp_rect));
+				nodes.realloc(w -padding);
+				
+				stbrp_context ctx;
+				stbrp_init_target(&ctx, (s32)(w -padding), (s32)(MAX_ATLAS_SIZE -padding), nodes.arr, (s32)nodes.len);
+				stbrp_setup_heuristic(&ctx, STBRP_HEURISTIC_Skyline_BF_sortHeight); // packs tighter than the default, and sorts by height like it
+				if (!stbrp_pack_rects(&ctx, trial.arr, (s32)count)) continue;
+				
+				u32 h = 0;
+				for (auto& r : trial) h = MAX(h, (u32)(r.y +r.h));
+				h += padding;
+				
+				if (best_w == 0 || (u64)w*h < (u64)best_w*best_h) {
+					best_w = w;
+					best_h = h;
+					memcpy(rects, trial.arr, count * sizeof(stbrp_rect));
+				}
+			}
+			
+			*out_w = best_w;
+			*out_h = best_h;
+			return best_w != 0;
+		}
+		
+		// fraction of the packed atlas covered by glyphs
+		f32 get_occupancy (Texture cr packed) {
+			u64 glyph_area = 0;
+			for (auto& c : chars) glyph_area += (u64)(c.x1 -c.x0) * (c.y1 -c.y0);
+			return (f32)glyph_area / (f32)(packed.w * packed.h);
+		}
+		
+		// the slow path, loads both fonts and packs the glyphs with stb_truetype into the smallest atlas they fit
+		void pack_atlas (Texture* packed) {
+			auto f = load_file(font_filepaths[0]);
+			defer { f.free(); };
+			
+			auto jp_f = load_file(font_filepaths[1]);
+			defer { jp_f.free(); };
+			
+			stbtt_fontinfo info, jp_info;
+			dbg_assert( stbtt_InitFont(&info, f.data, stbtt_GetFontOffsetForIndex(f.data, 0)) );
+			dbg_assert( stbtt_InitFont(&jp_info, jp_f.data, stbtt_GetFontOffsetForIndex(jp_f.data, 0)) );
 			
+			f32 sz = font_sizes[0];
+			f32 jpsz = font_sizes[1];
 			
 			stbtt_pack_range ranges[] = {
 				{ sz, ASCII_FIRST, nullptr, ASCII_NUM, &chars[ASCII_INDX] },
 				{ sz, 0, (int*)&DE_CHARS, DE_NUM, &chars[DE_INDX] },
 			};
-			dbg_assert( stbtt_PackFontRanges(&spc, f.data, 0, ranges, arrlent(s32, ranges)) > 0);
-			
-			
 			stbtt_pack_range ranges_jp[] = {
 				{ jpsz, 0, (int*)&JP_CHARS, JP_NUM, &chars[JP_INDX] },
 				{ jpsz, JP_HG_FIRST, nullptr, JP_HG_NUM, &chars[JP_HG_INDX] },
 			};
-			dbg_assert( stbtt_PackFontRanges(&spc, jp_f.data, 0, ranges_jp, arrlent(s32, ranges_jp)) > 0);
 			
+			// the glyph sizes first, then the atlas size, then render into the packed rects
+			static stbrp_rect rects[TOTAL_CHARS];
+			
+			stbtt_pack_context spc;
+			stbtt_PackBegin(&spc, nullptr, MAX_ATLAS_SIZE,MAX_ATLAS_SIZE, 0, 1, nullptr);
+			
+			//stbtt_PackSetOversampling(&spc, 1,1);
+			
+			u32 count = stbtt_PackFontRangesGatherRects(&spc, &info, ranges, arrlent(s32, ranges), rects);
+			u32 count_jp = stbtt_PackFontRangesGatherRects(&spc, &jp_info, ranges_jp, arrlent(s32, ranges_jp), rects +count);
+			dbg_assert(count +count_jp == TOTAL_CHARS);
 			stbtt_PackEnd(&spc);
 			
-			tex.inplace_vertical_flip(); // TODO: could get rid of this simply by flipping the uv's of the texture
+			u32 w, h;
+			dbg_assert( pack_rects_minimal(rects, TOTAL_CHARS, 1, &w, &h), "glyphs don't fit into %ux%u", MAX_ATLAS_SIZE, MAX_ATLAS_SIZE);
 			
-			glBindTexture(GL_TEXTURE_2D, tex.gl);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, tex.w,tex.h, 0, GL_RED, GL_UNSIGNED_BYTE, tex.data);
+			packed->alloc(w, h);
 			
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL,	0);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,	0);
+			stbtt_PackBegin(&spc, packed->data, (s32)w,(s32)h, (s32)w, 1, nullptr);
+			stbtt_PackFontRangesRenderIntoRects(&spc, &info, ranges, arrlent(s32, ranges), rects);
+			stbtt_PackFontRangesRenderIntoRects(&spc, &jp_info, ranges_jp, arrlent(s32, ranges_jp), rects +count);
+			stbtt_PackEnd(&spc);
+			
+			packed->inplace_vertical_flip(); // TODO: could get rid of this simply by flipping the uv's of the texture
+		}
+		
+		// stbtt can't pack distance fields, so generate them glyph by glyph and pack the rects with stb_rect_pack
+		void pack_atlas_sdf (Texture* packed) {
+			stbtt_fontinfo infos[2];
+			File_Data files[2];
+			for (u32 i=0; i<2; ++i) {
+				files[i] = load_file(font_filepaths[i]);
+				dbg_assert( stbtt_InitFont(&infos[i], files[i].data, stbtt_GetFontOffsetForIndex(files[i].data, 0)) );
+			}
+			defer { for (auto& f : files) f.free(); };
+			
+			struct Sdf_Glyph {
+				u8*		bitmap; // null for empty glyphs
+				s32		w, h;
+				s32		xoff, yoff;
+			};
+			static Sdf_Glyph	glyphs[TOTAL_CHARS];
+			static stbrp_rect	rects[TOTAL_CHARS];
+			
+			// generating the distance fields is most of the time, every glyph is independent
+			parallel_for(TOTAL_CHARS, get_thread_count(), [&] (u32 begin, u32 end, u32 chunk_i) {
+				for (u32 i=begin; i<end; ++i) {
+					u32 f;
+					utf32 u = packed_codepoint((int)i, &f);
+					
+					stbtt_fontinfo* info = &infos[f];
+					f32 scale = stbtt_ScaleForPixelHeight(info, font_sizes[f]);
+					int glyph_i = stbtt_FindGlyphIndex(info, (int)u);
+					
+					auto& g = glyphs[i];
+					g = {};
+					g.bitmap = stbtt_GetGlyphSDF(info, scale, glyph_i, SDF_PADDING, SDF_ONEDGE, SDF_PIXEL_DIST_SCALE, &g.w,&g.h, &g.xoff,&g.yoff);
+					if (!g.bitmap) g.w = g.h = 0;
+					
+					rects[i] = {};
+					rects[i].id = (int)i;
+					rects[i].w = g.w +1; // +a column and row of padding, like the packed coverage glyphs
+					rects[i].h = g.h +1;
+					
+					int advance, lsb;
+					stbtt_GetGlyphHMetrics(info, glyph_i, &advance, &lsb);
+					chars[i].xadvance = scale * (f32)advance;
+				}
+			});
+			
+			u32 w, h;
+			dbg_assert( pack_rects_minimal(rects, TOTAL_CHARS, 0, &w, &h), "glyphs don't fit into %ux%u", MAX_ATLAS_SIZE, MAX_ATLAS_SIZE);
+			
+			packed->alloc(w, h);
+			memset(packed->data, 0, packed->w*packed->h);
+			
+			for (int i=0; i<TOTAL_CHARS; ++i) {
+				auto& g = glyphs[i];
+				auto& r = rects[i];
+				for (s32 y=0; y<g.h; ++y) {
+					memcpy((*packed)[r.y +y] +r.x, &g.bitmap[y*g.w], g.w);
+				}
+				stbtt_FreeSDF(g.bitmap, nullptr);
+				
+				auto& c = chars[i];
+				c.x0 =		(u16)r.x;
+				c.y0 =		(u16)r.y;
+				c.x1 =		(u16)(r.x +g.w);
+				c.y1 =		(u16)(r.y +g.h);
+				c.xoff =	(f32)g.xoff;
+				c.yoff =	(f32)g.yoff;
+				c.xoff2 =	(f32)(g.xoff +g.w);
+				c.yoff2 =	(f32)(g.yoff +g.h);
+			}
+			
+			packed->inplace_vertical_flip();
+		}
+		
+		// packed->data points into the mapped blob
+		bool load_atlas_blob (cstr blob_filepath, u64 key, File_Data* blob, Texture* packed) {
+			*blob = load_file(blob_filepath);
+			if (!blob->data) return false;
+			
+			Atlas_Blob_Header h;
+			bool ok = blob->size >= sizeof(h);
+			if (ok) {
+				memcpy(&h, blob->data, sizeof(h));
+				ok =	h.magic == ATLAS_BLOB_MAGIC && h.version == ATLAS_BLOB_VERSION && h.key == key && h.char_count == TOTAL_CHARS
+					&&	blob->size == sizeof(h) +sizeof(chars) +(u64)h.tex_w*h.tex_h;
+			}
+			if (!ok) {
+				blob->free();
+				return false;
+			}
+			
+			memcpy(chars, blob->data +sizeof(h), sizeof(chars));
+			
+			packed->w =		h.tex_w;
+			packed->h =		h.tex_h;
+			packed->data =	(u8*)(blob->data +sizeof(h) +sizeof(chars)); // only read
 			return true;
 		}
+		bool save_atlas_blob (cstr blob_filepath, u64 key, Texture cr packed) {
+			auto f = fopen(blob_filepath, "wb");
+			if (!f) return false;
+			defer { fclose(f); };
+			
+			Atlas_Blob_Header h = {};
+			h.magic =		ATLAS_BLOB_MAGIC;
+			h.version =		ATLAS_BLOB_VERSION;
+			h.key =			key;
+			h.tex_w =		packed.w;
+			h.tex_h =		packed.h;
+			h.char_count =	TOTAL_CHARS;
+			
+			return		fwrite(&h, sizeof(h), 1, f) == 1
+					&&	fwrite(chars, sizeof(chars), 1, f) == 1
+					&&	fwrite(packed.data, packed.w*packed.h, 1, f) == 1;
+		}
+		
+		// the atlas texture is the empty cells with the packed glyphs after them
+		//  the packed glyphs stay where they were in packed relative to the end of the atlas, since their uvs are flipped (1 -t), so chars stays valid
+		void init_atlas (Texture cr packed) {
+			cell_size = (u32)ceil(MAX(font_sizes[0], font_sizes[1]) * 1.25f); // ascender to descender of most fonts
+			if (sdf) cell_size += SDF_PADDING*2;
+			cell_size = (cell_size +3) / 4 * 4; // +room for the padding
+			
+			u32 w = MAX(packed.w, DYNAMIC_ATLAS_WIDTH);
+			cells_per_row = w / cell_size;
+			cell_rows = (DYNAMIC_CELLS +cells_per_row -1) / cells_per_row;
+			
+			u32 cells_h = cell_rows * cell_size;
+			tex.alloc(w, cells_h +packed.h);
+			memset(tex.data, 0, tex.w*tex.h);
+			
+			for (u32 y=0; y<packed.h; ++y) {
+				memcpy(tex[cells_h +y], &packed.data[y*packed.w], packed.w);
+			}
+			
+			cells.realloc(cells_per_row * cell_rows);
+			memset(cells.arr, 0, cells.len * sizeof(Cell));
+			cell_chars.realloc(cells.len);
+			
+			frame = 1;
+		}
+		
+		// glyph index of a codepoint, the glyph gets rasterized into a cell first if it is not in the atlas
+		int get_glyph (utf32 u) {
+			int glyph = map_char(u);
+			if (glyph == GLYPH_NOT_RESIDENT) glyph = rasterize_glyph(u);
+			
+			if (glyph >= TOTAL_CHARS) cells[glyph -TOTAL_CHARS].last_used = frame;
+			return glyph;
+		}
+		stbtt_packedchar const* get_packedchar (int glyph) {
+			return glyph < TOTAL_CHARS ? &chars[glyph] : &cell_chars[glyph -TOTAL_CHARS];
+		}
+		
+		void map_fonts () {
+			for (u32 i=0; i<2; ++i) {
+				font_files[i] = load_file(font_filepaths[i]);
+				if (!font_files[i].data || !stbtt_InitFont(&font_infos[i], font_files[i].data, stbtt_GetFontOffsetForIndex(font_files[i].data, 0))) {
+					fprintf(stderr, "could not load font %s\n", font_filepaths[i]);
+					font_files[i].free();
+				}
+			}
+			fonts_mapped = true;
+		}
+		
+		int rasterize_glyph (utf32 u) {
+			int missing = map_char('!');
+			
+			if (!fonts_mapped) map_fonts();
+			
+			// the first font that has it
+			u32 f;
+			int glyph_i = 0;
+			for (f=0; f<2; ++f) {
+				if (!font_files[f].data) continue;
+				glyph_i = stbtt_FindGlyphIndex(&font_infos[f], (int)u);
+				if (glyph_i) break;
+			}
+			if (glyph_i == 0) {
+				set_glyph(u, missing); // in neither font, don't look again
+				return missing;
+			}
+			
+			// least recently used cell (free ones have never been used), cells used this frame can't be reused, their glyphs might already be laid out
+			u32 cell_i = cells.len;
+			for (u32 i=0; i<cells.len; ++i) {
+				if (cells[i].codepoint && cells[i].last_used == frame) continue;
+				if (cell_i == cells.len || cells[i].last_used < cells[cell_i].last_used) cell_i = i;
+			}
+			if (cell_i == cells.len) return missing; // more different glyphs than cells in a single frame
+			
+			auto& cell = cells[cell_i];
+			u32 old_w = 0, old_h = 0;
+			if (cell.codepoint) {
+				set_glyph(cell.codepoint, GLYPH_NOT_RESIDENT);
+				old_w = cell_chars[cell_i].x1 -cell_chars[cell_i].x0;
+				old_h = cell_chars[cell_i].y1 -cell_chars[cell_i].y0;
+			}
+			cell.codepoint = u;
+			cell.last_used = frame;
+			++cell.generation;
+			
+			stbtt_fontinfo* info = &font_infos[f];
+			f32 scale = stbtt_ScaleForPixelHeight(info, font_sizes[f]);
+			
+			static dynarr<u8> bitmap; // static so it starts out zeroed
+			bitmap.realloc(cell_size*cell_size);
+			memset(bitmap.arr, 0, bitmap.len);
+			
+			// a row and column of padding like the packed glyphs, so filtering never reaches into the next cell
+			int x0, y0;
+			u32 w, h;
+			if (sdf) {
+				int sdf_w = 0, sdf_h = 0;
+				u8* sdf_bitmap = stbtt_GetGlyphSDF(info, scale, glyph_i, SDF_PADDING, SDF_ONEDGE, SDF_PIXEL_DIST_SCALE, &sdf_w,&sdf_h, &x0,&y0);
+				if (!sdf_bitmap) { sdf_w = 0; sdf_h = 0; x0 = 0; y0 = 0; }
+				defer { stbtt_FreeSDF(sdf_bitmap, nullptr); };
+				
+				w = MIN((u32)sdf_w, cell_size -1);
+				h = MIN((u32)sdf_h, cell_size -1);
+				for (u32 y=0; y<h; ++y) memcpy(&bitmap[y*cell_size], &sdf_bitmap[y*sdf_w], w);
+			} else {
+				int x1, y1;
+				stbtt_GetGlyphBitmapBox(info, glyph_i, scale,scale, &x0,&y0,&x1,&y1);
+				
+				w = MIN((u32)(x1 -x0), cell_size -1);
+				h = MIN((u32)(y1 -y0), cell_size -1);
+				stbtt_MakeGlyphBitmap(info, bitmap.arr, (s32)w,(s32)h, (s32)cell_size, scale,scale, glyph_i);
+			}
+			
+			// flipped into the atlas like the packed glyphs and into the upload for the render thread
+			u32 cx = (cell_i % cells_per_row) * cell_size;
+			u32 cy = (cell_i / cells_per_row) * cell_size;
+			
+			//  only the rect of the glyph, or of the evicted one if that was bigger, so it gets cleared in the same upload
+			//  everything else in the cell is still empty from when the atlas was created
+			u32 upload_w = MAX(w, old_w);
+			u32 upload_h = MAX(h, old_h);
+			if (upload_w > 0 && upload_h > 0) {
+				u32 upload = upload_pixels.pushn(upload_w*upload_h);
+				for (u32 y=0; y<upload_h; ++y) {
+					u8 const* src = y < h ? &bitmap[(h -1 -y) * cell_size] : &bitmap[(cell_size -1) * cell_size]; // the last row is always empty
+					memcpy(&tex[cy +y][cx], src, upload_w);
+					memcpy(&upload_pixels[upload +y*upload_w], src, upload_w);
+				}
+				glyph_uploads.push({ cell_i, upload, upload_w, upload_h });
+			}
+			
+			int advance, lsb;
+			stbtt_GetGlyphHMetrics(info, glyph_i, &advance, &lsb);
+			
+			auto& c = cell_chars[cell_i];
+			c.x0 =			(u16)cx;
+			c.x1 =			(u16)(cx +w);
+			c.y0 =			(u16)(tex.h -(cy +h)); // flipped
+			c.y1 =			(u16)(tex.h -cy);
+			c.xoff =		(f32)x0;
+			c.yoff =		(f32)y0;
+			c.xoff2 =		(f32)(x0 +(s32)w);
+			c.yoff2 =		(f32)(y0 +(s32)h);
+			c.xadvance =	scale * (f32)advance;
+			
+			set_glyph(u, TOTAL_CHARS +cell_i);
+			++glyphs_rasterized;
+			return TOTAL_CHARS +cell_i;
+		}
 		
 		static array<utf32> utf8_to_utf32 (array<utf8 const> cr str) {
 			utf8 const* cur = str.arr;
@@ -263,10 +927,76 @@ namespace font {
 			return ret;
 		}
 		
+		// only looks up (or lays out) the line, record hands the lines to the render thread
 		//void draw_text_lines (Basic_Shader cr shad, array< array<utf8>* > text_lines, v2 pos_screen, v4 col) {
-		void draw_text_lines (Basic_Shader cr shad, array<utf8 const> cr text_, v2 pos_screen, v4 col) {
+		// size in pixels, 0 for the size the font was inited with, other sizes are only sharp with sdf
+		void draw_text_lines (Basic_Shader cr shad, array<utf8 const> cr text_, v2 pos_screen, v4 col, f32 size=0) {
+			dbg_assert(text_.len > 0);
+			if (size == 0) size = this->size;
+			
+			u32 text_len = 0; // the array is the whole print_array buffer
+			while (text_len < text_.len && text_[text_len] != '\0') ++text_len;
+			array<utf8 const> text = { text_.arr, text_len };
+			
+			rgba8 c = pack_rgba8(col);
+			
+			u64 hash = hash_bytes(text.arr, text.len);
+			hash = hash_bytes(&pos_screen, sizeof(pos_screen), hash);
+			hash = hash_bytes(&c, sizeof(c), hash);
+			hash = hash_bytes(&size, sizeof(size), hash);
+			hash = hash_bytes(&wnd_dim, sizeof(wnd_dim), hash);
+			
+			u32 free_i = layouts.len;
+			for (u32 i=0; i<layouts.len; ++i) {
+				auto& l = layouts[i];
+				if (!l.alive) {
+					if (free_i == layouts.len) free_i = i;
+					continue;
+				}
+				if (		l.hash == hash && l.text.len == text.len && memcmp(l.text.arr, text.arr, text.len) == 0
+						&&	l.pos_screen.x == pos_screen.x && l.pos_screen.y == pos_screen.y && memcmp(&l.col, &c, sizeof(c)) == 0 && l.size == size
+						&&	l.wnd_dim.x == wnd_dim.x && l.wnd_dim.y == wnd_dim.y) {
+							
+					bool evicted = false;
+					for (auto& ref : l.cells) evicted = evicted || cells[ref.cell].generation != ref.generation;
+					
+					if (evicted) { // can't have been drawn this frame, its glyphs would not have been evicted then
+						free_layout(i);
+						if (free_i == layouts.len) free_i = i;
+						continue;
+					}
+					
+					for (auto& ref : l.cells) cells[ref.cell].last_used = frame;
+					
+					drawn.push(i);
+					return;
+				}
+			}
+			
+			if (free_i == layouts.len) layouts.push({});
+			
+			auto& l = layouts[free_i];
+			l.alive =		true;
+			l.hash =		hash;
+			l.pos_screen =	pos_screen;
+			l.col =			c;
+			l.size =		size;
+			l.wnd_dim =		wnd_dim;
+			l.capacity =	0;
+			
+			l.text.realloc(text.len);
+			memcpy(l.text.arr, text.arr, text.len);
+			
+			layout(text_, pos_screen, c, size, &l.verts, &l.cells);
+			
+			drawn.push(free_i);
+			++rebuilds;
+		}
+		
+		void layout (array<utf8 const> cr text_, v2 pos_screen, rgba8 col, f32 size, dynarr<Text_Vertex>* verts, dynarr<Text_Layout::Cell_Ref>* cell_refs) {
 			
 			v2 pos = v2(pos_screen.x, pos_screen.y -wnd_dim.y);
+			f32 scale = size / font_sizes[0]; // the atlas is at font_sizes
 			
 			constexpr v2 _quad[] = {
 				v2(1,0),
@@ -277,33 +1007,45 @@ namespace font {
 				v2(0,1),
 			};
 			
-			dbg_assert(text_.len > 0);
-			
 			array<utf32> line = utf8_to_utf32(text_);
 			dbg_assert(line.len > 0);
 			defer { line.free(); };
 			
 			#define SHOW_TEXTURE 0
 			
-			auto text_data = array<VBO_Pos_Tex_Col::V>::malloc( line.len * 6
+			verts->realloc( (line.len -1) * 6 // without null terminator
 					#if SHOW_TEXTURE
 					+6
 					#endif
 					);
 			
-			auto* out = &text_data[0];
+			auto* out = verts->arr;
+			cell_refs->realloc(0);
 			
 			for (u32 i=0; i<line.len-1; ++i) {
 				utf32 c = line[i];
 				
+				int glyph = get_glyph(c);
+				if (glyph >= TOTAL_CHARS) cell_refs->push({ (u32)(glyph -TOTAL_CHARS), cells[glyph -TOTAL_CHARS].generation });
+				
 				stbtt_aligned_quad quad;
 				
-				stbtt_GetPackedQuad(chars, (s32)tex.w,(s32)tex.h, map_char(c),
-						&pos.x,&pos.y, &quad, 1);
+				v2 advance = 0; // quad relative to the pen, so it can be scaled
+				stbtt_GetPackedQuad(get_packedchar(glyph), (s32)tex.w,(s32)tex.h, 0,
+						&advance.x,&advance.y, &quad, 0);
+						
+				v2 p0 = pos +v2(quad.x0, quad.y0) * scale;
+				v2 p1 = p0 +v2(quad.x1 -quad.x0, quad.y1 -quad.y0) * scale;
+				if (!sdf) { // coverage glyphs are only sharp on whole pixels
+					v2 snap = v2(floor(p0.x +0.5f), floor(p0.y +0.5f)) -p0;
+					p0 += snap;
+					p1 += snap;
+				}
+				pos.x += advance.x * scale;
 				
 				for (u32 vert_i=0; vert_i<6; ++vert_i) {
-					out->pos =	lerp(v2(quad.x0,-quad.y0), v2(quad.x1,-quad.y1), _quad[vert_i]) / (v2)wnd_dim * 2 -1;
-					out->uv =	lerp(v2(quad.s0,-quad.t0), v2(quad.s1,-quad.t1), _quad[vert_i]);
+					out->pos =	lerp(v2(p0.x,-p0.y), v2(p1.x,-p1.y), _quad[vert_i]) / (v2)wnd_dim * 2 -1;
+					out->uv =	pack_unorm16x2( lerp(v2(quad.s0,1 -quad.t0), v2(quad.s1,1 -quad.t1), _quad[vert_i]) ); // 1-t samples the same as -t did (texture repeats), but fits into unorm
 					out->col =	col;
 					++out;
 				}
@@ -312,19 +1054,193 @@ namespace font {
 			#if SHOW_TEXTURE
 			for (u32 j=0; j<6; ++j) {
 				out->pos =	lerp( ((v2)wnd_dim -v2((f32)tex.w,(f32)tex.h)) / (v2)wnd_dim * 2 -1, 1, _quad[j]);
-				out->uv =	_quad[j];
+				out->uv =	pack_unorm16x2(_quad[j]);
 				out->col =	col;
 				++out;
 			}
 			#endif
 			
 			#undef SHOW_TEXTURE
+		}
+		// same quads into the software rasterizer, has to happen before record()
+		void draw_soft (Soft_Raster* r) {
+			static dynarr<Soft_Raster::Vertex> verts; // static so it starts out zeroed
+			verts.realloc(0);
+			
+			for (u32 i : drawn) {
+				auto& l = layouts[i];
+				u32 offs = verts.pushn(l.verts.len);
+				for (u32 j=0; j<l.verts.len; ++j) {
+					auto& v = l.verts[j];
+					verts[offs +j] = { v.pos, v2(v.uv.x, v.uv.y) / 65535, v4(v.col.r, v.col.g, v.col.b, v.col.a) / 255 };
+				}
+			}
+			// nearest sampling, so distance fields get the edge at the default size for all lines
+			f32 distance_scale = sdf ? 255 / SDF_PIXEL_DIST_SCALE * size / font_sizes[0] : 0;
+			r->draw(Soft_Raster::TRIANGLES, verts, m4::ident(), { tex.data, tex.w, tex.h, distance_scale });
+		}
+		
+		// records the uploads of newly rasterized glyphs, drops the lines that were not drawn since the last record, records the uploads of new ones and one draw of all drawn lines
+		void record (Render_Frame* f) {
+			for (auto& u : glyph_uploads) {
+				f->upload_glyph(u.cell, u.w, { &upload_pixels[u.first], u.w*u.h });
+			}
+			glyph_uploads.realloc(0);
+			upload_pixels.realloc(0);
+			
+			for (u32 i=0; i<layouts.len; ++i) {
+				if (!layouts[i].alive) continue;
+				
+				bool was_drawn = false;
+				for (u32 d : drawn) was_drawn = was_drawn || d == i;
+				if (!was_drawn) free_layout(i);
+			}
+			
+			// free ranges never get merged, once too much of the buffer is wasted all lines get packed to the front again
+			if (resident_used > resident_live*2 +ALLOC_GRANULARITY*layouts.len) {
+				resident_used = 0;
+				resident_live = 0;
+				resident_free.realloc(0);
+				for (auto& l : layouts) l.capacity = 0;
+			}
+			
+			for (auto& l : layouts) {
+				if (!l.alive || l.capacity > 0) continue;
+				
+				alloc_resident(&l);
+				f->upload_text(l.first, l.verts);
+			}
+			
+			static dynarr<s32> firsts; // static so they start out zeroed
+			static dynarr<s32> counts;
+			firsts.realloc(drawn.len);
+			counts.realloc(drawn.len);
+			for (u32 i=0; i<drawn.len; ++i) {
+				firsts[i] = (s32)layouts[drawn[i]].first;
+				counts[i] = (s32)layouts[drawn[i]].verts.len;
+			}
+			f->draw_text(firsts, counts);
+			
+			lines_last_frame = drawn.len;
+			rebuilds_last_frame = rebuilds;
+			rebuilds = 0;
+			glyphs_rasterized_last_frame = glyphs_rasterized;
+			glyphs_rasterized = 0;
+			drawn.realloc(0);
+			
+			++frame;
+		}
+		
+		// render thread side of record
+		void upload_glyph (Render_Frame cr f, Render_Cmd cr cmd) {
+			u32 cell = cmd.arg & 0xffff;
+			u32 w = cmd.arg >> 16;
+			u32 x = (cell % cells_per_row) * cell_size;
+			u32 y = (cell / cells_per_row) * cell_size;
+			
+			glBindTexture(GL_TEXTURE_2D, tex.gl);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, x,y, w,cmd.count / w, GL_RED, GL_UNSIGNED_BYTE, &f.atlas_pixels[cmd.first]);
+			++render_stats.state_changes;
+		}
+		
+		// render thread side of record
+		void upload (Render_Frame cr f, Render_Cmd cr cmd) {
+			if (f.text_verts_used > resident_capacity) grow_resident_buffer(f.text_verts_used);
+			
+			glBindBuffer(GL_ARRAY_BUFFER, resident_vbo);
+			glBufferSubData(GL_ARRAY_BUFFER, cmd.arg*sizeof(Text_Vertex), cmd.count*sizeof(Text_Vertex), &f.text_verts[cmd.first]);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		void bind () {
+			bind_vao(resident_vao);
+		}
+		
+	private:
+		void free_layout (u32 i) {
+			auto& l = layouts[i];
+			if (l.capacity > 0) {
+				resident_free.push({ l.first, l.capacity });
+				resident_live -= l.capacity;
+			}
+			l.text.free();
+			l.verts.free();
+			l.cells.free();
+			l = {};
+		}
+		
+		void alloc_resident (Text_Layout* l) {
+			u32 size = (l->verts.len +ALLOC_GRANULARITY -1) / ALLOC_GRANULARITY * ALLOC_GRANULARITY;
+			size = MAX(size, ALLOC_GRANULARITY);
+			
+			l->capacity = size;
+			resident_live += size;
+			
+			for (u32 i=0; i<resident_free.len; ++i) {
+				auto& r = resident_free[i];
+				if (r.count < size) continue;
+				
+				l->first = r.first;
+				r.first += size;
+				r.count -= size;
+				if (r.count == 0) resident_free.delete_by_moving_last(i);
+				return;
+			}
+			
+			l->first = resident_used;
+			resident_used += size;
+		}
+		
+		void init_resident_buffer (u32 initial_capacity=16*1024) {
+			resident_capacity = initial_capacity;
+			
+			glGenBuffers(1, &resident_vbo);
+			glBindBuffer(GL_ARRAY_BUFFER, resident_vbo);
+			glBufferData(GL_ARRAY_BUFFER, resident_capacity*sizeof(Text_Vertex), NULL, GL_DYNAMIC_DRAW);
+			
+			glGenVertexArrays(1, &resident_vao);
+			glBindVertexArray(resident_vao);
+			Text_Vertex::set_attrib_pointers();
+			
+			glBindVertexArray(0);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			bound_vao = 0;
+		}
+		// keeps the contents, the lines that are not uploaded again this frame are still drawn from it
+		void grow_resident_buffer (u32 min_capacity) {
+			u32 new_capacity = resident_capacity;
+			while (new_capacity < min_capacity) new_capacity *= 2;
+			
+			GLuint new_vbo;
+			glGenBuffers(1, &new_vbo);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, new_vbo);
+			glBufferData(GL_COPY_WRITE_BUFFER, new_capacity*sizeof(Text_Vertex), NULL, GL_DYNAMIC_DRAW);
+			
+			glBindBuffer(GL_COPY_READ_BUFFER, resident_vbo);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, resident_capacity*sizeof(Text_Vertex));
+			
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
 			
-			vbo.upload(text_data);
-			vbo.bind(shad);
+			glDeleteBuffers(1, &resident_vbo);
+			resident_vbo = new_vbo;
+			resident_capacity = new_capacity;
 			
-			glDrawArrays(GL_TRIANGLES, 0, text_data.len);
+			// the vao captured the old buffer
+			glBindVertexArray(resident_vao);
+			glBindBuffer(GL_ARRAY_BUFFER, resident_vbo);
+			Text_Vertex::set_attrib_pointers();
+			glBindVertexArray(0);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			bound_vao = 0;
 		}
 	};
+	constexpr u32 Font::MAX_ATLAS_SIZE;
+	constexpr f32 Font::SDF_SIZE;
+	constexpr s32 Font::SDF_PADDING;
+	constexpr u8 Font::SDF_ONEDGE;
+	constexpr f32 Font::SDF_PIXEL_DIST_SCALE;
+	constexpr u32 Font::DYNAMIC_CELLS;
+	constexpr u32 Font::DYNAMIC_ATLAS_WIDTH;
+	constexpr u32 Font::ALLOC_GRANULARITY;
 	
 }
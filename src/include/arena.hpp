@@ -0,0 +1,101 @@
+
+// bump allocator made of chained blocks
+//  reset() rewinds to the first block in O(1) and keeps all blocks around for reuse, so memory only grows to the peak of a session
+struct Arena {
+	struct Block {
+		Block*	next;
+		uptr	size; // usable bytes following the header
+
+		byte* data () { return (byte*)(this +1); }
+	};
+
+	Block*	first;
+	Block*	cur;
+	byte*	ptr; // next free byte in cur
+	byte*	end; // end of cur
+
+	uptr	reserved; // bytes malloced for all blocks (what the process actually holds)
+	uptr	used; // bytes handed out since last reset (including alignment padding)
+
+	static constexpr uptr BLOCK_SIZE = 64 * 1024;
+
+	byte* alloc (uptr size, uptr align=16) {
+		for (;;) {
+			byte* p = (byte*)(((uptr)ptr +(align -1)) & ~(align -1));
+			if (cur && p +size <= end) {
+				used += (p +size) -ptr;
+				ptr = p +size;
+				return p;
+			}
+			next_block(size +align);
+		}
+	}
+	template <typename T> T* alloc () {
+		return (T*)alloc(sizeof(T), alignof(T));
+	}
+
+	void reset () {
+		cur = first;
+		ptr = cur ? cur->data() : nullptr;
+		end = cur ? ptr +cur->size : nullptr;
+		used = 0;
+	}
+	void free () {
+		for (Block* b=first; b;) {
+			Block* next = b->next;
+			::free(b);
+			b = next;
+		}
+		*this = {};
+	}
+
+private:
+	void next_block (uptr min_size) {
+		if (cur) used += end -ptr; // rest of the block is wasted
+
+		Block* b = cur ? cur->next : first;
+		if (!b || b->size < min_size) { // insert a new block after cur, blocks too small for this alloc stay in the chain for later
+			uptr size = MAX(BLOCK_SIZE, min_size);
+
+			Block* nb = (Block*)::malloc(sizeof(Block) +size);
+			nb->next = b;
+			nb->size = size;
+			reserved += sizeof(Block) +size;
+
+			if (cur)	cur->next = nb;
+			else		first = nb;
+			b = nb;
+		}
+
+		cur = b;
+		ptr = b->data();
+		end = ptr +b->size;
+	}
+};
+
+// fixed size object allocator on top of an Arena, freed objects get reused by later allocs
+//  the free list is only valid until the arena is reset, so call reset() together with the arena
+template <typename T>
+struct Arena_Pool {
+	STATIC_ASSERT(sizeof(T) >= sizeof(void*));
+
+	Arena*	arena;
+	void*	free_list;
+
+	T* alloc () {
+		if (free_list) {
+			void* p = free_list;
+			free_list = *(void**)p;
+			return (T*)p;
+		}
+		return (T*)arena->alloc(sizeof(T), MAX(alignof(T), alignof(void*))); // freed objects hold the free list pointer
+	}
+	void free (T* p) {
+		*(void**)p = free_list;
+		free_list = p;
+	}
+
+	void reset () {
+		free_list = nullptr;
+	}
+};
@@ -0,0 +1,28 @@
+
+#include <thread>
+
+static u32 get_thread_count () {
+	u32 n = std::thread::hardware_concurrency(); // 0 if unknown
+	return clamp((s32)n, 1, 64);
+}
+
+// splits [0,count) into chunks and runs f(u32 begin, u32 end, u32 chunk_i) for each chunk on its own thread
+//  the calling thread does chunk 0 itself, returns after all chunks are done
+template <typename FUNC>
+static void parallel_for (u32 count, u32 chunks, FUNC f) {
+	chunks = clamp((s32)MIN(chunks, count), 1, 64);
+	
+	std::thread threads[64];
+	
+	u32 chunk_size = (count +chunks -1) / chunks;
+	for (u32 c=1; c<chunks; ++c) {
+		u32 begin = MIN(c * chunk_size, count);
+		u32 end = MIN(begin +chunk_size, count);
+		threads[c] = std::thread(f, begin, end, c);
+	}
+	f(0u, MIN(chunk_size, count), 0u);
+	
+	for (u32 c=1; c<chunks; ++c) {
+		threads[c].join();
+	}
+}
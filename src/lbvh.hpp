@@ -0,0 +1,233 @@
+
+#if RZ_COMP == RZ_COMP_MSVC
+	#include <intrin.h>
+	static u32 count_leading_zeros (u32 x) {
+		unsigned long i;
+		return _BitScanReverse(&i, x) ? 31 -i : 32;
+	}
+#else
+	static u32 count_leading_zeros (u32 x) {
+		return x ? __builtin_clz(x) : 32;
+	}
+#endif
+
+// linear bvh over entity bounding boxes in the wrapped world, rebuilt every tick from morton codes (Karras 2012)
+//  unlike Spatial_Grid it does not care how uneven the entities are distributed
+//  arrays are reused between builds, so the bvh has to start out zeroed (static)
+struct LBVH {
+	struct AABB {
+		v2	lo;
+		v2	hi;
+	};
+	static constexpr u32 LEAF = 0x80000000u; // child index flag, the rest is the sorted leaf index
+	
+	struct Node {
+		AABB	box;
+		u32		left;
+		u32		right;
+	};
+	
+	v2				world_radius;
+	u32				count;
+	
+	dynarr<Node>	nodes; // count-1 internal nodes, nodes[0] is the root
+	dynarr<AABB>	leaf_boxes; // in sorted order
+	dynarr<u32>		sorted; // entity indices in morton order
+	dynarr<u32>		codes; // sorted morton codes, +3*count space for the radix sort
+	dynarr<v2>		pos; // entity positions by entity index
+	
+	// get_pos(u32 indx) -> v2, get_radius(u32 indx) -> f32
+	template <typename GET_POS, typename GET_RADIUS>
+	void build (u32 count, GET_POS get_pos, GET_RADIUS get_radius, v2 world_radius) {
+		this->world_radius = world_radius;
+		this->count = count;
+		
+		if (nodes.len != MAX(count, 1u) -1)	nodes.realloc(MAX(count, 1u) -1);
+		if (leaf_boxes.len != count)		leaf_boxes.realloc(count);
+		if (sorted.len != count)			sorted.realloc(count);
+		if (codes.len != count*4)			codes.realloc(count*4);
+		if (pos.len != count)				pos.realloc(count);
+		if (count == 0) return;
+		
+		u32* keys = codes.arr;
+		u32* vals = sorted.arr;
+		for (u32 i=0; i<count; ++i) {
+			pos[i] = get_pos(i);
+			keys[i] = morton_code(pos[i], world_radius);
+			vals[i] = i;
+		}
+		radix_sort_parallel(keys, vals, keys +count, keys +count*2, count);
+		
+		for (u32 i=0; i<count; ++i) {
+			u32 e = sorted[i];
+			f32 r = get_radius(e);
+			leaf_boxes[i] = { pos[e] -r, pos[e] +r };
+		}
+		
+		if (count == 1) return;
+		
+		// every internal node can be built independently
+		if (count >= (1u << 16)) {
+			parallel_for(count -1, get_thread_count(), [this] (u32 begin, u32 end, u32 chunk_i) {
+				for (u32 i=begin; i<end; ++i) build_node(i);
+			});
+		} else {
+			for (u32 i=0; i<count -1; ++i) build_node(i);
+		}
+		
+		compute_bounds();
+	}
+	
+	// calls f(u32 indx, v2 delta) for every entity whose box overlaps the circle's box (a broad phase test)
+	//  delta is the shortest vector from p to the entity, radius has to be smaller than the world
+	template <typename FUNC> void query (v2 p, f32 radius, FUNC f) const {
+		if (count == 0) return;
+		
+		AABB root = count == 1 ? leaf_boxes[0] : nodes[0].box;
+		
+		// the query box and its copies across the seams (entity boxes can stick out of the world a bit)
+		for (s32 y=-1; y<=+1; ++y) {
+			for (s32 x=-1; x<=+1; ++x) {
+				v2 offs = world_radius*2 * v2((f32)x,(f32)y);
+				AABB q = { p +offs -radius, p +offs +radius };
+				if (!overlap(q, root)) continue;
+				
+				traverse(q, [&] (u32 leaf) {
+					u32 indx = sorted[leaf];
+					f(indx, torus_delta(p, pos[indx], world_radius));
+				});
+			}
+		}
+	}
+	
+	// calls f(u32 a, u32 b, v2 delta) once for every pair of entities whose boxes overlap, delta being the shortest vector from a to b
+	template <typename FUNC> void query_pairs (FUNC f) const {
+		if (count < 2) return;
+		
+		for (u32 leaf=0; leaf<count; ++leaf) {
+			AABB box = leaf_boxes[leaf];
+			v2 p = (box.lo +box.hi) * 0.5f;
+			v2 r = (box.hi -box.lo) * 0.5f;
+			
+			for (s32 y=-1; y<=+1; ++y) {
+				for (s32 x=-1; x<=+1; ++x) {
+					v2 offs = world_radius*2 * v2((f32)x,(f32)y);
+					AABB q = { p +offs -r, p +offs +r };
+					if (!overlap(q, nodes[0].box)) continue;
+					
+					traverse(q, [&] (u32 other) {
+						if (other <= leaf) return; // each pair once
+						u32 a = sorted[leaf];
+						u32 b = sorted[other];
+						f(a, b, torus_delta(pos[a], pos[b], world_radius));
+					});
+				}
+			}
+		}
+	}
+	
+	void free () {
+		nodes.free();
+		leaf_boxes.free();
+		sorted.free();
+		codes.free();
+		pos.free();
+	}
+	
+private:
+	static bool overlap (AABB cr a, AABB cr b) {
+		return a.lo.x <= b.hi.x && a.hi.x >= b.lo.x && a.lo.y <= b.hi.y && a.hi.y >= b.lo.y;
+	}
+	static AABB merge (AABB cr a, AABB cr b) {
+		return { MIN(a.lo, b.lo), MAX(a.hi, b.hi) };
+	}
+	
+	// calls f(u32 leaf) for every leaf overlapping q
+	template <typename FUNC> void traverse (AABB cr q, FUNC f) const {
+		if (count == 1) { // no internal nodes
+			if (overlap(q, leaf_boxes[0])) f(0u);
+			return;
+		}
+		
+		u32 stack[128]; // tree depth is at most 64 (32 code bits +32 index bits)
+		u32 sp = 0;
+		stack[sp++] = 0;
+		
+		while (sp) {
+			Node cr n = nodes[ stack[--sp] ];
+			for (u32 child : { n.left, n.right }) {
+				if (child & LEAF) {
+					u32 leaf = child & ~LEAF;
+					if (overlap(q, leaf_boxes[leaf])) f(leaf);
+				} else if (overlap(q, nodes[child].box)) {
+					dbg_assert(sp < arrlen(stack));
+					stack[sp++] = child;
+				}
+			}
+		}
+	}
+	
+	// length of the common prefix of the codes of sorted leaves i and j, duplicate codes are made unique by their index
+	s32 delta (u32 i, s32 j) const {
+		if (j < 0 || j >= (s32)count) return -1;
+		u32 a = codes[i];
+		u32 b = codes[j];
+		if (a == b) return 32 +(s32)count_leading_zeros(i ^ (u32)j);
+		return (s32)count_leading_zeros(a ^ b);
+	}
+	void build_node (u32 i) {
+		s32 si = (s32)i;
+		
+		// direction of the range covered by this node
+		s32 d = delta(i, si +1) -delta(i, si -1) >= 0 ? +1 : -1;
+		s32 delta_min = delta(i, si -d);
+		
+		// upper bound for the length of the range, then binary search for the other end
+		s32 len_max = 2;
+		while (delta(i, si +len_max*d) > delta_min) len_max *= 2;
+		
+		s32 len = 0;
+		for (s32 t=len_max/2; t>=1; t/=2) {
+			if (delta(i, si +(len +t)*d) > delta_min) len += t;
+		}
+		s32 j = si +len*d;
+		
+		// binary search for the split position
+		s32 delta_node = delta(i, j);
+		s32 split = 0;
+		for (s32 t=(len +1)/2;; t=(t +1)/2) {
+			if (delta(i, si +(split +t)*d) > delta_node) split += t;
+			if (t == 1) break;
+		}
+		s32 gamma = si +split*d +MIN(d, 0);
+		
+		nodes[i].left =		MIN(si, j) == gamma		? (u32)gamma		| LEAF : (u32)gamma;
+		nodes[i].right =	MAX(si, j) == gamma +1	? (u32)(gamma +1)	| LEAF : (u32)(gamma +1);
+	}
+	// internal node boxes, post order from the root
+	void compute_bounds () {
+		u32 stack[256];
+		u32 sp = 0;
+		stack[sp++] = 0;
+		
+		auto get_box = [&] (u32 child) -> AABB cr {
+			return child & LEAF ? leaf_boxes[child & ~LEAF] : nodes[child].box;
+		};
+		
+		// second visit of a node (marked with LEAF since it can't be on the stack as a leaf) merges the children
+		while (sp) {
+			u32 n = stack[--sp];
+			if (n & LEAF) {
+				n &= ~LEAF;
+				nodes[n].box = merge(get_box(nodes[n].left), get_box(nodes[n].right));
+				continue;
+			}
+			
+			dbg_assert(sp +3 <= arrlen(stack));
+			stack[sp++] = n | LEAF;
+			if (!(nodes[n].left & LEAF))	stack[sp++] = nodes[n].left;
+			if (!(nodes[n].right & LEAF))	stack[sp++] = nodes[n].right;
+		}
+	}
+};
+constexpr u32 LBVH::LEAF;
@@ -0,0 +1,568 @@
+
+#if RZ_ARCH == RZ_ARCH_X64
+	#include <emmintrin.h>
+	#define SOFT_RASTER_SSE 1
+#else
+	#define SOFT_RASTER_SSE 0
+#endif
+
+// 4 lanes of f32, sse2 on x64, plain loops everywhere else
+#if SOFT_RASTER_SSE
+struct f32x4 {
+	__m128	v;
+	
+	static FORCEINLINE f32x4 set1 (f32 x) {						return { _mm_set1_ps(x) }; }
+	static FORCEINLINE f32x4 set (f32 a, f32 b, f32 c, f32 d) {	return { _mm_setr_ps(a,b,c,d) }; }
+	
+	friend FORCEINLINE f32x4 operator+ (f32x4 l, f32x4 r) {		return { _mm_add_ps(l.v, r.v) }; }
+	friend FORCEINLINE f32x4 operator- (f32x4 l, f32x4 r) {		return { _mm_sub_ps(l.v, r.v) }; }
+	friend FORCEINLINE f32x4 operator* (f32x4 l, f32x4 r) {		return { _mm_mul_ps(l.v, r.v) }; }
+	
+	// lane bitmasks
+	friend FORCEINLINE u32 mask_ge (f32x4 l, f32x4 r) {			return (u32)_mm_movemask_ps(_mm_cmpge_ps(l.v, r.v)); }
+	friend FORCEINLINE u32 mask_gt (f32x4 l, f32x4 r) {			return (u32)_mm_movemask_ps(_mm_cmpgt_ps(l.v, r.v)); }
+	
+	FORCEINLINE void store (f32* out) const {					_mm_storeu_ps(out, v); }
+};
+static FORCEINLINE void store_4_pixels (u32* out, u32 col) {	_mm_storeu_si128((__m128i*)out, _mm_set1_epi32((s32)col)); }
+#else
+struct f32x4 {
+	f32		v[4];
+	
+	static FORCEINLINE f32x4 set1 (f32 x) {						return {{ x,x,x,x }}; }
+	static FORCEINLINE f32x4 set (f32 a, f32 b, f32 c, f32 d) {	return {{ a,b,c,d }}; }
+	
+	friend FORCEINLINE f32x4 operator+ (f32x4 l, f32x4 r) {		for (u32 i=0; i<4; ++i) l.v[i] += r.v[i];	return l; }
+	friend FORCEINLINE f32x4 operator- (f32x4 l, f32x4 r) {		for (u32 i=0; i<4; ++i) l.v[i] -= r.v[i];	return l; }
+	friend FORCEINLINE f32x4 operator* (f32x4 l, f32x4 r) {		for (u32 i=0; i<4; ++i) l.v[i] *= r.v[i];	return l; }
+	
+	friend FORCEINLINE u32 mask_ge (f32x4 l, f32x4 r) {
+		u32 m = 0;
+		for (u32 i=0; i<4; ++i) m |= (u32)(l.v[i] >= r.v[i]) << i;
+		return m;
+	}
+	friend FORCEINLINE u32 mask_gt (f32x4 l, f32x4 r) {
+		u32 m = 0;
+		for (u32 i=0; i<4; ++i) m |= (u32)(l.v[i] > r.v[i]) << i;
+		return m;
+	}
+	
+	FORCEINLINE void store (f32* out) const {					for (u32 i=0; i<4; ++i) out[i] = v[i]; }
+};
+static FORCEINLINE void store_4_pixels (u32* out, u32 col) {	for (u32 i=0; i<4; ++i) out[i] = col; }
+#endif
+
+// pixel coordinate to int, clamped while still a float, since casting a float outside of the s32 range is undefined (vertices far outside of the view)
+static FORCEINLINE s32 floor_clamped (f32 x, s32 lo, s32 hi) {	return (s32)floor(clamp(x, (f32)lo, (f32)hi)); }
+static FORCEINLINE s32 ceil_clamped (f32 x, s32 lo, s32 hi) {	return (s32)ceil(clamp(x, (f32)lo, (f32)hi)); }
+
+// software render backend for machines without a gpu and for checking frames headless
+//  renders the same primitives as the gl path (triangles, lines and points with vertex colors, alpha textured triangles for text) into an in-memory RGBA8 framebuffer
+//  draw() only transforms and records, flush() bins the primitives into tiles and rasterizes the tiles in parallel
+//  primitives are processed in submission order per tile, so blending (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA) is ordered like on the gpu
+//  colors are linear and blended in linear space, the framebuffer is srgb (like GL_FRAMEBUFFER_SRGB)
+//  has to start out zeroed (static)
+struct Soft_Raster {
+	enum prim_e : u32 {
+		TRIANGLES	=0,
+		LINES		,
+		POINTS		,
+	};
+	
+	struct Vertex {
+		v2		pos;
+		v2		uv;
+		v4		col; // linear
+	};
+	struct Texture { // single channel alpha like the font atlas, row 0 is at v=0, repeats
+		u8 const*	data; // null for untextured
+		u32			w;
+		u32			h;
+		f32			distance_scale; // 0: texels are alpha, otherwise a distance field with the edge at 0.5, alpha = (texel -0.5) * distance_scale +0.5
+	};
+	
+	static constexpr u32 TILE_SIZE = 64;
+	
+	u32				threads;
+	
+	u32				w;
+	u32				h;
+	u32				tiles_x;
+	u32				tiles_y;
+	dynarr<u32>		pixels; // RGBA8 srgb, row 0 at the top
+	
+	u64				pixels_written; // by the last flush, for fill rate numbers
+	
+	void init (u32 w, u32 h, u32 threads=get_thread_count()) {
+		this->threads = clamp((s32)threads, 1, 64);
+		this->w = w;
+		this->h = h;
+		tiles_x = (w +TILE_SIZE -1) / TILE_SIZE;
+		tiles_y = (h +TILE_SIZE -1) / TILE_SIZE;
+		
+		if (pixels.len != w*h) pixels.realloc(w*h);
+		
+		for (u32 i=0; i<256; ++i) {
+			f32 c = (f32)i / 255;
+			to_linear[i] = c <= 0.04045f ? c / 12.92f : pow((c +0.055f) / 1.055f, 2.4f);
+		}
+		for (u32 i=0; i<arrlen(to_srgb); ++i) {
+			f32 l = (f32)i / (arrlen(to_srgb) -1);
+			f32 c = l <= 0.0031308f ? l * 12.92f : 1.055f * pow(l, 1.0f / 2.4f) -0.055f;
+			to_srgb[i] = (u8)(clamp(c, 0.0f, 1.0f) * 255 +0.5f);
+		}
+	}
+	
+	void clear (v4 col) {
+		u32 c = encode(col);
+		for (auto& p : pixels) p = c;
+	}
+	
+	// vertecies get transformed by to_clip (then treated like gl clip space), tex only applies to triangles
+	void draw (prim_e type, array<Vertex> cr vertecies, m4 cr to_clip, Texture tex={}, f32 point_size=1) {
+		u32 prim_verts = type == TRIANGLES ? 3 : (type == LINES ? 2 : 1);
+		u32 prim_count = vertecies.len / prim_verts;
+		
+		u32 first = verts.pushn(prim_count * prim_verts);
+		for (u32 i=0; i<prim_count * prim_verts; ++i) {
+			Vertex v = vertecies[i];
+			v4 clip = to_clip * v4(v.pos, 0, 1);
+			v.pos = (v2(clip.x, clip.y) * v2(0.5f, -0.5f) +0.5f) * v2((f32)w, (f32)h);
+			verts[first +i] = v;
+		}
+		
+		u32 p = prims.pushn(prim_count);
+		for (u32 i=0; i<prim_count; ++i) {
+			prims[p +i] = { type, first +i*prim_verts, tex, point_size };
+		}
+	}
+	
+	// rasterizes everything drawn since the last flush
+	void flush () {
+		u32 tile_count = tiles_x * tiles_y;
+		u32 chunks = prims.len >= 1024 ? threads : 1; // threads are not worth it for a handful of primitives
+		
+		// bin in parallel, counts per chunk and tile first, so that the scatter keeps submission order in every tile
+		if (bin_counts.len != chunks*tile_count) bin_counts.realloc(chunks*tile_count);
+		for (auto& c : bin_counts) c = 0;
+		
+		parallel_for(prims.len, chunks, [this, tile_count] (u32 begin, u32 end, u32 chunk_i) {
+			u32* counts = &bin_counts[chunk_i*tile_count];
+			for (u32 i=begin; i<end; ++i) {
+				iv2 t0, t1;
+				if (!get_tile_range(prims[i], &t0, &t1)) continue;
+				for (s32 ty=t0.y; ty<t1.y; ++ty)
+					for (s32 tx=t0.x; tx<t1.x; ++tx)
+						++counts[ty*tiles_x +tx];
+			}
+		});
+		
+		if (bin_start.len != tile_count +1) bin_start.realloc(tile_count +1);
+		u32 total = 0;
+		for (u32 tile=0; tile<tile_count; ++tile) {
+			bin_start[tile] = total;
+			for (u32 c=0; c<chunks; ++c) {
+				u32 count = bin_counts[c*tile_count +tile];
+				bin_counts[c*tile_count +tile] = total;
+				total += count;
+			}
+		}
+		bin_start[tile_count] = total;
+		
+		if (bins.len != total) bins.realloc(total);
+		
+		parallel_for(prims.len, chunks, [this, tile_count] (u32 begin, u32 end, u32 chunk_i) {
+			u32* offs = &bin_counts[chunk_i*tile_count];
+			for (u32 i=begin; i<end; ++i) {
+				iv2 t0, t1;
+				if (!get_tile_range(prims[i], &t0, &t1)) continue;
+				for (s32 ty=t0.y; ty<t1.y; ++ty)
+					for (s32 tx=t0.x; tx<t1.x; ++tx)
+						bins[ offs[ty*tiles_x +tx]++ ] = i;
+			}
+		});
+		
+		// tiles don't overlap, so they can be rasterized without any synchronization
+		u64 written[64] = {};
+		parallel_for(tile_count, threads, [this, &written] (u32 begin, u32 end, u32 chunk_i) {
+			for (u32 tile=begin; tile<end; ++tile) {
+				written[chunk_i] += raster_tile(tile);
+			}
+		});
+		
+		pixels_written = 0;
+		for (u64 n : written) pixels_written += n;
+		
+		verts.realloc(0);
+		prims.realloc(0);
+	}
+	
+	// writes the framebuffer as a 32 bit .bmp
+	bool dump (cstr filename) const {
+		FILE* f = fopen(filename, "wb");
+		if (!f) return false;
+		defer { fclose(f); };
+		
+		u32 data_size = w*h*4;
+		
+		u8 header[54] = {};
+		auto put_u32 = [&] (u32 offs, u32 val) { memcpy(&header[offs], &val, 4); };
+		auto put_u16 = [&] (u32 offs, u16 val) { memcpy(&header[offs], &val, 2); };
+		header[0] = 'B';
+		header[1] = 'M';
+		put_u32(2,	(u32)sizeof(header) +data_size);
+		put_u32(10,	(u32)sizeof(header));
+		put_u32(14,	40); // BITMAPINFOHEADER
+		put_u32(18,	w);
+		put_u32(22,	h); // positive -> rows bottom up
+		put_u16(26,	1);
+		put_u16(28,	32);
+		put_u32(34,	data_size);
+		
+		if (fwrite(header, sizeof(header), 1, f) != 1) return false;
+		
+		auto row = array<u8>::malloc(w*4);
+		defer { row.free(); };
+		
+		for (u32 y=h; y-- > 0;) {
+			for (u32 x=0; x<w; ++x) {
+				u32 p = pixels[y*w +x];
+				row[x*4 +0] = (u8)(p >> 16); // BGRA
+				row[x*4 +1] = (u8)(p >>  8);
+				row[x*4 +2] = (u8)(p >>  0);
+				row[x*4 +3] = (u8)(p >> 24);
+			}
+			if (fwrite(row.arr, row.len, 1, f) != 1) return false;
+		}
+		return true;
+	}
+	
+	void free () {
+		pixels.free();
+		verts.free();
+		prims.free();
+		bin_counts.free();
+		bin_start.free();
+		bins.free();
+	}
+	
+private:
+	struct Prim {
+		prim_e		type;
+		u32			first_vert; // in verts
+		Texture		tex;
+		f32			point_size;
+	};
+	
+	dynarr<Vertex>	verts; // in pixel space
+	dynarr<Prim>	prims;
+	
+	dynarr<u32>		bin_counts; // [chunk][tile], turned into write offsets
+	dynarr<u32>		bin_start; // [tile] first entry in bins, +1 entry for the end
+	dynarr<u32>		bins; // primitive indices, grouped by tile
+	
+	f32				to_linear[256];
+	u8				to_srgb[4096];
+	
+	u32 encode (v4 c) const {
+		auto srgb = [&] (f32 l) -> u32 { return to_srgb[ (u32)(clamp(l, 0.0f, 1.0f) * (arrlen(to_srgb) -1) +0.5f) ]; };
+		u32 a = (u32)(clamp(c.w, 0.0f, 1.0f) * 255 +0.5f);
+		return srgb(c.x) | srgb(c.y) << 8 | srgb(c.z) << 16 | a << 24;
+	}
+	v4 decode (u32 p) const {
+		return v4(to_linear[p & 0xff], to_linear[(p >> 8) & 0xff], to_linear[(p >> 16) & 0xff], (f32)(p >> 24) / 255);
+	}
+	void blend (u32* dst, v4 src) const {
+		if (src.w >= 1) {
+			*dst = encode(src);
+		} else if (src.w > 0) {
+			*dst = encode(src * src.w +decode(*dst) * (1 -src.w));
+		}
+	}
+	
+	// all vertecies with the same color, no need to interpolate
+	bool has_uniform_color (Prim cr p, u32 prim_verts) const {
+		v4 c = verts[p.first_vert].col;
+		for (u32 i=1; i<prim_verts; ++i) {
+			v4 o = verts[p.first_vert +i].col;
+			if (o.x != c.x || o.y != c.y || o.z != c.z || o.w != c.w) return false;
+		}
+		return true;
+	}
+	// untextured with one opaque color, can just write the encoded color
+	bool is_flat_opaque (Prim cr p, u32 prim_verts) const {
+		return !p.tex.data && verts[p.first_vert].col.w >= 1 && has_uniform_color(p, prim_verts);
+	}
+	
+	// pixel bounds of a primitive, including line width and point size
+	bool get_pixel_bounds (Prim cr p, v2* lo, v2* hi) const {
+		u32 prim_verts = p.type == TRIANGLES ? 3 : (p.type == LINES ? 2 : 1);
+		*lo = verts[p.first_vert].pos;
+		*hi = *lo;
+		for (u32 i=1; i<prim_verts; ++i) {
+			*lo = MIN(*lo, verts[p.first_vert +i].pos);
+			*hi = MAX(*hi, verts[p.first_vert +i].pos);
+		}
+		f32 pad = p.type == POINTS ? p.point_size * 0.5f : (p.type == LINES ? 1.0f : 0.0f);
+		*lo -= pad;
+		*hi += pad;
+		return hi->x >= 0 && hi->y >= 0 && lo->x < (f32)w && lo->y < (f32)h;
+	}
+	bool get_tile_range (Prim cr p, iv2* t0, iv2* t1) const {
+		v2 lo, hi;
+		if (!get_pixel_bounds(p, &lo, &hi)) return false;
+		t0->x = floor_clamped(lo.x, 0, (s32)w -1) / (s32)TILE_SIZE;
+		t0->y = floor_clamped(lo.y, 0, (s32)h -1) / (s32)TILE_SIZE;
+		t1->x = floor_clamped(hi.x, 0, (s32)w -1) / (s32)TILE_SIZE +1;
+		t1->y = floor_clamped(hi.y, 0, (s32)h -1) / (s32)TILE_SIZE +1;
+		return true;
+	}
+	
+	// returns pixels written
+	u64 raster_tile (u32 tile) {
+		s32 x0 = (s32)((tile % tiles_x) * TILE_SIZE);
+		s32 y0 = (s32)((tile / tiles_x) * TILE_SIZE);
+		s32 x1 = MIN(x0 +(s32)TILE_SIZE, (s32)w);
+		s32 y1 = MIN(y0 +(s32)TILE_SIZE, (s32)h);
+		
+		u64 written = 0;
+		for (u32 i=bin_start[tile]; i<bin_start[tile +1]; ++i) {
+			Prim cr p = prims[ bins[i] ];
+			switch (p.type) {
+				case TRIANGLES:	written += raster_triangle(p, x0,y0, x1,y1);	break;
+				case LINES:		written += raster_line(p, x0,y0, x1,y1);		break;
+				case POINTS:	written += raster_point(p, x0,y0, x1,y1);		break;
+				default: dbg_assert(false);
+			}
+		}
+		return written;
+	}
+	
+	u64 raster_triangle (Prim cr p, s32 x0, s32 y0, s32 x1, s32 y1) {
+		Vertex const* v[3] = { &verts[p.first_vert], &verts[p.first_vert +1], &verts[p.first_vert +2] };
+		
+		f32 area = (v[1]->pos.x -v[0]->pos.x) * (v[2]->pos.y -v[0]->pos.y) -(v[1]->pos.y -v[0]->pos.y) * (v[2]->pos.x -v[0]->pos.x);
+		if (area == 0) return 0;
+		if (area < 0) { // no culling, just make the winding consistent
+			Vertex const* tmp = v[1];
+			v[1] = v[2];
+			v[2] = tmp;
+			area = -area;
+		}
+		f32 inv_area = 1.0f / area;
+		
+		// edge functions e_i(x,y) = a*x +b*y +c of the edge opposite to vertex i, all >= 0 inside
+		f32 ea[3], eb[3], ec[3];
+		bool inclusive[3];
+		for (u32 i=0; i<3; ++i) {
+			v2 s = v[(i +1) % 3]->pos;
+			v2 t = v[(i +2) % 3]->pos;
+			ea[i] = -(t.y -s.y);
+			eb[i] = t.x -s.x;
+			ec[i] = -(ea[i]*s.x +eb[i]*s.y);
+			// pixels exactly on an edge go to only one of the triangles sharing it (which see the edge with opposite signs), so quads don't blend their diagonal twice
+			inclusive[i] = ea[i] > 0 || (ea[i] == 0 && eb[i] > 0);
+		}
+		
+		v2 lo = MIN(MIN(v[0]->pos, v[1]->pos), v[2]->pos);
+		v2 hi = MAX(MAX(v[0]->pos, v[1]->pos), v[2]->pos);
+		s32 bx0 = floor_clamped(lo.x, x0, x1);
+		s32 by0 = floor_clamped(lo.y, y0, y1);
+		s32 bx1 = ceil_clamped(hi.x, x0, x1);
+		s32 by1 = ceil_clamped(hi.y, y0, y1);
+		if (bx0 >= bx1 || by0 >= by1) return 0;
+		
+		bool flat = is_flat_opaque(p, 3);
+		u32 flat_col = flat ? encode(v[0]->col) : 0;
+		bool uniform = has_uniform_color(p, 3);
+		
+		// edge function at a pixel center
+		auto edge = [&] (u32 i, s32 x, s32 y) { return ea[i]*((f32)x +0.5f) +eb[i]*((f32)y +0.5f) +ec[i]; };
+		
+		// big triangles (the world background, full screen quads) usually cover the whole tile, edge functions are linear so checking the corners is enough
+		if (flat) {
+			bool covered = true;
+			for (u32 i=0; i<3; ++i) {
+				covered = covered && edge(i, bx0,by0) > 0 && edge(i, bx1-1,by0) > 0 && edge(i, bx0,by1-1) > 0 && edge(i, bx1-1,by1-1) > 0;
+			}
+			if (covered) {
+				for (s32 y=by0; y<by1; ++y) {
+					u32* row = &pixels[y*w];
+					s32 x = bx0;
+					for (; x+4<=bx1; x+=4) store_4_pixels(&row[x], flat_col);
+					for (; x<bx1; ++x) row[x] = flat_col;
+				}
+				return (u64)(bx1 -bx0) * (by1 -by0);
+			}
+		}
+		
+		f32x4 lane_x = f32x4::set(0.5f, 1.5f, 2.5f, 3.5f);
+		f32x4 zero = f32x4::set1(0);
+		f32x4 step0 = f32x4::set1(ea[0] * 4);
+		f32x4 step1 = f32x4::set1(ea[1] * 4);
+		f32x4 step2 = f32x4::set1(ea[2] * 4);
+		// mask_gt for exclusive edges, ge | gt for inclusive ones, without a branch per edge
+		u32 incl0 = inclusive[0] ? 0xf : 0;
+		u32 incl1 = inclusive[1] ? 0xf : 0;
+		u32 incl2 = inclusive[2] ? 0xf : 0;
+		
+		u64 written = 0;
+		for (s32 y=by0; y<by1; ++y) {
+			f32 py = (f32)y +0.5f;
+			f32x4 px = f32x4::set1((f32)bx0) +lane_x;
+			
+			f32x4 e0 = f32x4::set1(ea[0]) * px +f32x4::set1(eb[0]*py +ec[0]);
+			f32x4 e1 = f32x4::set1(ea[1]) * px +f32x4::set1(eb[1]*py +ec[1]);
+			f32x4 e2 = f32x4::set1(ea[2]) * px +f32x4::set1(eb[2]*py +ec[2]);
+			
+			u32* row = &pixels[y*w];
+			for (s32 x=bx0; x<bx1; x+=4, e0 = e0 +step0, e1 = e1 +step1, e2 = e2 +step2) {
+				u32 mask = (mask_gt(e0, zero) | (mask_ge(e0, zero) & incl0))
+				         & (mask_gt(e1, zero) | (mask_ge(e1, zero) & incl1))
+				         & (mask_gt(e2, zero) | (mask_ge(e2, zero) & incl2));
+				if (bx1 -x < 4) mask &= (1u << (bx1 -x)) -1;
+				if (!mask) continue;
+				
+				if (mask == 0xf && flat) {
+					store_4_pixels(&row[x], flat_col);
+					written += 4;
+					continue;
+				}
+				
+				f32 w0[4], w1[4], w2[4];
+				e0.store(w0);
+				e1.store(w1);
+				e2.store(w2);
+				
+				for (u32 lane=0; lane<4; ++lane) {
+					if (!(mask & (1u << lane))) continue;
+					
+					if (flat) {
+						row[x +lane] = flat_col;
+					} else {
+						f32 l0 = w0[lane] * inv_area;
+						f32 l1 = w1[lane] * inv_area;
+						f32 l2 = w2[lane] * inv_area;
+						
+						v4 col = uniform ? v[0]->col : v[0]->col*l0 +v[1]->col*l1 +v[2]->col*l2;
+						if (p.tex.data) {
+							v2 uv = v[0]->uv*l0 +v[1]->uv*l1 +v[2]->uv*l2;
+							col.w *= sample_alpha(p.tex, uv);
+						}
+						blend(&row[x +lane], col);
+					}
+					++written;
+				}
+			}
+		}
+		return written;
+	}
+	
+	// 1 pixel wide, one pixel per column (or row for steep lines) with the pixel center on the line, end pixel excluded like gl
+	u64 raster_line (Prim cr p, s32 x0, s32 y0, s32 x1, s32 y1) {
+		Vertex const* a = &verts[p.first_vert];
+		Vertex const* b = &verts[p.first_vert +1];
+		
+		bool x_major = abs(b->pos.x -a->pos.x) >= abs(b->pos.y -a->pos.y);
+		
+		// major/minor axis coordinates and the tile range on both
+		f32 am = x_major ? a->pos.x : a->pos.y;
+		f32 an = x_major ? a->pos.y : a->pos.x;
+		f32 bm = x_major ? b->pos.x : b->pos.y;
+		f32 bn = x_major ? b->pos.y : b->pos.x;
+		s32 lo_m = x_major ? x0 : y0;
+		s32 hi_m = x_major ? x1 : y1;
+		s32 lo_n = x_major ? y0 : x0;
+		s32 hi_n = x_major ? y1 : x1;
+		
+		if (am > bm) {
+			Vertex const* tmp = a;	a = b;	b = tmp;
+			f32 t;
+			t = am;	am = bm;	bm = t;
+			t = an;	an = bn;	bn = t;
+		}
+		if (bm == am) return 0;
+		
+		f32 slope = (bn -an) / (bm -am);
+		f32 inv_len = 1.0f / (bm -am);
+		
+		s32 m0 = ceil_clamped(am -0.5f, lo_m, hi_m);
+		s32 m1 = ceil_clamped(bm -0.5f, lo_m, hi_m);
+		
+		bool flat = is_flat_opaque(p, 2);
+		u32 flat_col = flat ? encode(a->col) : 0;
+		
+		f32x4 lane_m = f32x4::set(0.5f, 1.5f, 2.5f, 3.5f);
+		
+		u64 written = 0;
+		for (s32 m=m0; m<m1; m+=4) {
+			f32x4 center = f32x4::set1((f32)m) +lane_m;
+			f32x4 t = (center -f32x4::set1(am)) * f32x4::set1(inv_len);
+			f32x4 minor = f32x4::set1(an) +(center -f32x4::set1(am)) * f32x4::set1(slope);
+			
+			f32 ts[4], ns[4];
+			t.store(ts);
+			minor.store(ns);
+			
+			s32 count = MIN(4, m1 -m);
+			
+			// shallow x major lines stay in one row for most groups of 4 pixels, which is a single 4 pixel store then
+			if (flat && x_major && count == 4) {
+				f32 row = floor(ns[0]);
+				if (row == floor(ns[3]) && row >= (f32)lo_n && row < (f32)hi_n) {
+					store_4_pixels(&pixels[(s32)row*w +m], flat_col);
+					written += 4;
+					continue;
+				}
+			}
+			
+			for (s32 lane=0; lane<count; ++lane) {
+				f32 nf = floor(ns[lane]);
+				if (!(nf >= (f32)lo_n && nf < (f32)hi_n)) continue; // before the cast, the minor coordinate can be far outside of the tile (or nan)
+				s32 n = (s32)nf;
+				
+				u32* px = x_major ? &pixels[n*w +(m +lane)] : &pixels[(m +lane)*w +n];
+				if (flat)	*px = flat_col;
+				else		blend(px, lerp(a->col, b->col, ts[lane]));
+				++written;
+			}
+		}
+		return written;
+	}
+	
+	// squares of point_size pixels like glPointSize without point smoothing
+	u64 raster_point (Prim cr p, s32 x0, s32 y0, s32 x1, s32 y1) {
+		Vertex const* v = &verts[p.first_vert];
+		f32 r = p.point_size * 0.5f;
+		
+		s32 px0 = ceil_clamped(v->pos.x -r -0.5f, x0, x1);
+		s32 py0 = ceil_clamped(v->pos.y -r -0.5f, y0, y1);
+		s32 px1 = ceil_clamped(v->pos.x +r -0.5f, x0, x1);
+		s32 py1 = ceil_clamped(v->pos.y +r -0.5f, y0, y1);
+		
+		bool flat = is_flat_opaque(p, 1);
+		u32 flat_col = flat ? encode(v->col) : 0;
+		
+		u64 written = 0;
+		for (s32 y=py0; y<py1; ++y) {
+			for (s32 x=px0; x<px1; ++x) {
+				if (flat)	pixels[y*w +x] = flat_col;
+				else		blend(&pixels[y*w +x], v->col);
+				++written;
+			}
+		}
+		return written;
+	}
+	
+	// nearest, repeating
+	static f32 sample_alpha (Texture cr tex, v2 uv) {
+		f32 u = uv.x -floor(uv.x);
+		f32 v = uv.y -floor(uv.y);
+		u32 x = MIN((u32)(u * tex.w), tex.w -1);
+		u32 y = MIN((u32)(v * tex.h), tex.h -1);
+		f32 a = (f32)tex.data[y*tex.w +x] / 255;
+		if (tex.distance_scale != 0) a = clamp((a -0.5f) * tex.distance_scale +0.5f, 0.0f, 1.0f);
+		return a;
+	}
+};
+constexpr u32 Soft_Raster::TILE_SIZE;
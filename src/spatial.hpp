@@ -0,0 +1,315 @@
+
+// shortest difference vector from a to b on the wrapped world (a torus of size 2*world_radius)
+//  a and b have to be inside the world already (like after wrap())
+static v2 torus_delta (v2 a, v2 b, v2 world_radius) {
+	v2 d = b -a;
+	if (		d.x >  world_radius.x)	d.x -= world_radius.x*2;
+	else if (	d.x < -world_radius.x)	d.x += world_radius.x*2;
+	if (		d.y >  world_radius.y)	d.y -= world_radius.y*2;
+	else if (	d.y < -world_radius.y)	d.y += world_radius.y*2;
+	return d;
+}
+
+// uniform grid over the wrapped world, meant to be rebuilt every tick (counting sort of entity indices into cells)
+//  queries respect the torus topology, so an entity just across the seam counts as close
+//  arrays are reused between builds, so the grid has to start out zeroed (static)
+struct Spatial_Grid {
+	v2			world_radius;
+	iv2			cells; // cell count per axis
+	v2			cell_size;
+	v2			inv_cell_size;
+	
+	dynarr<u32>	cell_start; // cells.x*cells.y +1 offsets into items
+	dynarr<u32>	items; // entity indices sorted by cell
+	dynarr<v2>	pos; // entity positions by entity index, copied so queries don't need to know the entity type
+	
+	u32 get_cell_i (iv2 c) const {
+		return c.y*cells.x +c.x;
+	}
+	iv2 get_cell (v2 p) const {
+		v2 c = (p +world_radius) * inv_cell_size;
+		return iv2(clamp((s32)c.x, 0,cells.x-1), clamp((s32)c.y, 0,cells.y-1));
+	}
+	
+	// target_cell_size gets rounded so that the cells exactly tile the world
+	//  get_pos(u32 indx) -> v2 returns the (wrapped) position of entity indx
+	template <typename GET_POS> void build (u32 count, GET_POS get_pos, v2 world_radius, f32 target_cell_size) {
+		this->world_radius = world_radius;
+		cells = iv2( MAX((s32)round(world_radius.x*2 / target_cell_size), 1),
+					 MAX((s32)round(world_radius.y*2 / target_cell_size), 1) );
+		cell_size = world_radius*2 / (v2)cells;
+		inv_cell_size = 1.0f / cell_size;
+		
+		u32 cell_count = cells.x * cells.y;
+		if (cell_start.len != cell_count +1)	cell_start.realloc(cell_count +1);
+		if (items.len != count)					items.realloc(count);
+		if (pos.len != count)					pos.realloc(count);
+		
+		memset(cell_start.arr, 0, cell_start.len * sizeof(u32));
+		
+		auto* cell_of = (u32*)malloc(count * sizeof(u32));
+		defer { ::free(cell_of); };
+		
+		for (u32 i=0; i<count; ++i) {
+			pos[i] = get_pos(i);
+			cell_of[i] = get_cell_i( get_cell(pos[i]) );
+			++cell_start[ cell_of[i] +1 ];
+		}
+		for (u32 i=0; i<cell_count; ++i) {
+			cell_start[i +1] += cell_start[i];
+		}
+		// scatter, uses the end offsets as a cursor and then shifts them back
+		for (u32 i=0; i<count; ++i) {
+			items[ cell_start[cell_of[i]]++ ] = i;
+		}
+		for (u32 i=cell_count; i>0; --i) {
+			cell_start[i] = cell_start[i -1];
+		}
+		cell_start[0] = 0;
+	}
+	void build (array<v2 const> positions, v2 world_radius, f32 target_cell_size) {
+		build(positions.len, [&] (u32 i) { return positions[i]; }, world_radius, target_cell_size);
+	}
+	
+	// calls f(u32 indx, v2 delta) for every entity with torus distance <= radius from p
+	//  delta is the shortest vector from p to the entity
+	template <typename FUNC> void query_radius (v2 p, f32 radius, FUNC f) const {
+		iv2 lo, hi;
+		get_cell_range(p, radius, &lo, &hi);
+		
+		iv2 c = get_cell(p);
+		f32 radius_sqr = radius*radius;
+		
+		for (s32 dy=lo.y; dy<=hi.y; ++dy) {
+			for (s32 dx=lo.x; dx<=hi.x; ++dx) {
+				u32 cell = get_cell_i( iv2( wrap_cell(c.x +dx, cells.x), wrap_cell(c.y +dy, cells.y) ) );
+				
+				for (u32 i=cell_start[cell]; i<cell_start[cell +1]; ++i) {
+					u32 indx = items[i];
+					v2 d = torus_delta(p, pos[indx], world_radius);
+					if (dot(d,d) <= radius_sqr) f(indx, d);
+				}
+			}
+		}
+	}
+	
+	// k nearest entities to p by torus distance, written to out_indx (and out_dist_sqr if not null) sorted nearest first
+	//  returns how many were found (< k if there are fewer entities than k within max_radius)
+	u32 query_knn (v2 p, u32 k, u32* out_indx, f32* out_dist_sqr=nullptr, f32 max_radius=BUILTIN_F32_INF) const {
+		if (k == 0) return 0;
+		
+		f32 tmp_dist[16];
+		f32* dist = out_dist_sqr;
+		if (!dist) {
+			dbg_assert(k <= arrlen(tmp_dist), "pass out_dist_sqr for k > %d", arrlen(tmp_dist));
+			dist = tmp_dist;
+		}
+		
+		u32 found = 0;
+		f32 max_dist_sqr = max_radius*max_radius;
+		
+		// window of unique cell offsets around p's cell, rings that would wrap onto themselves get clipped to this
+		iv2 win_lo = -(cells / 2);
+		iv2 win_hi = win_lo +cells -1;
+		
+		iv2 c = get_cell(p);
+		f32 min_cell_size = MIN(cell_size.x, cell_size.y);
+		
+		for (s32 r=0;; ++r) {
+			// no entity in ring r can be closer than this
+			f32 ring_min_dist = (f32)MAX(r -1, 0) * min_cell_size;
+			f32 ring_min_dist_sqr = ring_min_dist*ring_min_dist;
+			if (ring_min_dist_sqr > max_dist_sqr) break;
+			if (found == k && ring_min_dist_sqr > dist[k -1]) break;
+			
+			iv2 lo = iv2(MAX(-r, win_lo.x), MAX(-r, win_lo.y));
+			iv2 hi = iv2(MIN(+r, win_hi.x), MIN(+r, win_hi.y));
+			
+			for (s32 dy=lo.y; dy<=hi.y; ++dy) {
+				for (s32 dx=lo.x; dx<=hi.x; ++dx) {
+					if (MAX(abs(dx), abs(dy)) != r) continue; // inner rings were already visited
+					
+					u32 cell = get_cell_i( iv2( wrap_cell(c.x +dx, cells.x), wrap_cell(c.y +dy, cells.y) ) );
+					
+					for (u32 i=cell_start[cell]; i<cell_start[cell +1]; ++i) {
+						u32 indx = items[i];
+						v2 d = torus_delta(p, pos[indx], world_radius);
+						f32 dist_sqr = dot(d,d);
+						
+						if (dist_sqr > max_dist_sqr) continue;
+						if (found == k && dist_sqr >= dist[k -1]) continue;
+						
+						// insertion into the sorted result
+						u32 j = found < k ? found++ : k -1;
+						for (; j>0 && dist[j -1] > dist_sqr; --j) {
+							dist[j] = dist[j -1];
+							out_indx[j] = out_indx[j -1];
+						}
+						dist[j] = dist_sqr;
+						out_indx[j] = indx;
+					}
+				}
+			}
+			
+			if (lo.x == win_lo.x && hi.x == win_hi.x && lo.y == win_lo.y && hi.y == win_hi.y) break; // visited the whole grid
+		}
+		return found;
+	}
+	
+	void free () {
+		cell_start.free();
+		items.free();
+		pos.free();
+	}
+	
+private:
+	static s32 wrap_cell (s32 c, s32 count) {
+		if (c < 0)				return c +count;
+		if (c >= count)			return c -count;
+		return c;
+	}
+	// cell offsets relative to p's cell that can contain entities within radius, clipped so no cell is visited twice
+	void get_cell_range (v2 p, f32 radius, iv2* lo, iv2* hi) const {
+		iv2 c = get_cell(p);
+		v2 a = (p -radius +world_radius) * inv_cell_size;
+		v2 b = (p +radius +world_radius) * inv_cell_size;
+		*lo = iv2((s32)floor(a.x), (s32)floor(a.y)) -c;
+		*hi = iv2((s32)floor(b.x), (s32)floor(b.y)) -c;
+		
+		// range covers the whole axis (it would wrap onto itself), visit each cell once instead
+		iv2 win_lo = -(cells / 2);
+		iv2 win_hi = win_lo +cells -1;
+		if (hi->x -lo->x +1 >= cells.x) { lo->x = win_lo.x; hi->x = win_hi.x; }
+		if (hi->y -lo->y +1 >= cells.y) { lo->y = win_lo.y; hi->y = win_hi.y; }
+	}
+};
+
+// 16 bits spread out to every other bit
+static u32 morton_spread_bits (u32 x) {
+	x &= 0x0000ffff;
+	x = (x | (x << 8)) & 0x00ff00ff;
+	x = (x | (x << 4)) & 0x0f0f0f0f;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+	return x;
+}
+// z-order curve index of a position in the wrapped world, 16 bits per axis
+static u32 morton_code (v2 pos, v2 world_radius) {
+	v2 t = (pos +world_radius) / (world_radius*2) * 65535.0f;
+	u32 x = (u32)clamp(t.x, 0.0f, 65535.0f);
+	u32 y = (u32)clamp(t.y, 0.0f, 65535.0f);
+	return morton_spread_bits(x) | (morton_spread_bits(y) << 1);
+}
+
+// lsd radix sort of keys with their values, 8 bits per pass, the result ends up in keys/vals again
+//  tmp_keys, tmp_vals have to be count large
+static void radix_sort (u32* keys, u32* vals, u32* tmp_keys, u32* tmp_vals, u32 count) {
+	for (u32 shift=0; shift<32; shift += 8) {
+		u32 offsets[256] = {};
+		for (u32 i=0; i<count; ++i) {
+			++offsets[ (keys[i] >> shift) & 0xff ];
+		}
+		u32 sum = 0;
+		for (u32 i=0; i<256; ++i) {
+			u32 tmp = offsets[i];
+			offsets[i] = sum;
+			sum += tmp;
+		}
+		for (u32 i=0; i<count; ++i) {
+			u32 o = offsets[ (keys[i] >> shift) & 0xff ]++;
+			tmp_keys[o] = keys[i];
+			tmp_vals[o] = vals[i];
+		}
+		
+		u32* tmp;
+		tmp = keys; keys = tmp_keys; tmp_keys = tmp;
+		tmp = vals; vals = tmp_vals; tmp_vals = tmp;
+	}
+}
+
+// same as radix_sort, but histogram and scatter of each pass are split over threads (needs parallel.hpp)
+//  not worth the thread startup for small counts, those just use radix_sort
+static void radix_sort_parallel (u32* keys, u32* vals, u32* tmp_keys, u32* tmp_vals, u32 count) {
+	u32 threads = get_thread_count();
+	if (threads == 1 || count < (1u << 16)) {
+		radix_sort(keys, vals, tmp_keys, tmp_vals, count);
+		return;
+	}
+	
+	auto* offsets = (u32(*)[256])malloc(threads * sizeof(u32[256]));
+	defer { free(offsets); };
+	
+	for (u32 shift=0; shift<32; shift += 8) {
+		parallel_for(count, threads, [=] (u32 begin, u32 end, u32 chunk_i) {
+			u32* o = offsets[chunk_i];
+			memset(o, 0, sizeof(u32[256]));
+			for (u32 i=begin; i<end; ++i) {
+				++o[ (keys[i] >> shift) & 0xff ];
+			}
+		});
+		// all chunks of a digit go after all chunks of the previous digit, in chunk order to keep the sort stable
+		u32 sum = 0;
+		for (u32 digit=0; digit<256; ++digit) {
+			for (u32 t=0; t<threads; ++t) {
+				u32 tmp = offsets[t][digit];
+				offsets[t][digit] = sum;
+				sum += tmp;
+			}
+		}
+		parallel_for(count, threads, [=] (u32 begin, u32 end, u32 chunk_i) {
+			u32* o = offsets[chunk_i];
+			for (u32 i=begin; i<end; ++i) {
+				u32 j = o[ (keys[i] >> shift) & 0xff ]++;
+				tmp_keys[j] = keys[i];
+				tmp_vals[j] = vals[i];
+			}
+		});
+		
+		u32* tmp;
+		tmp = keys; keys = tmp_keys; tmp_keys = tmp;
+		tmp = vals; vals = tmp_vals; tmp_vals = tmp;
+	}
+}
+
+// reorders an array of entity pointers by morton code of the entity positions, and also moves the entities between their allocations
+//  so that walking the array in order also walks memory in order, and spatially close entities end up close in memory
+//  entity i ends up at index remap[i] (if remap is not null), indices or pointers to entities kept across this call have to be remapped with it
+//  get_pos(T const*) -> v2
+template <typename T, typename GET_POS>
+static void reorder_by_morton (array<T*> entities, v2 world_radius, GET_POS get_pos, dynarr<u32>* remap=nullptr) {
+	u32 count = entities.len;
+	if (remap && remap->len != count) remap->realloc(count);
+	if (count == 0) return;
+	
+	auto* keys = (u32*)malloc(count * 4*sizeof(u32));
+	defer { free(keys); };
+	u32* vals =		keys +count;
+	
+	for (u32 i=0; i<count; ++i) {
+		keys[i] = morton_code(get_pos(entities[i]), world_radius);
+		vals[i] = i;
+	}
+	radix_sort(keys, vals, vals +count, vals +count*2, count);
+	
+	// entity with the i-th smallest code goes into the i-th lowest allocation
+	auto* slots = (T**)malloc(count * sizeof(T*));
+	defer { free(slots); };
+	memcpy(slots, entities.arr, count * sizeof(T*));
+	
+	qsort(slots, count, sizeof(T*), [] (void const* l, void const* r) {
+		uptr a = *(uptr const*)l;
+		uptr b = *(uptr const*)r;
+		return a < b ? -1 : (a > b ? 1 : 0);
+	});
+	
+	auto* copies = (T*)malloc(count * sizeof(T));
+	defer { free(copies); };
+	for (u32 i=0; i<count; ++i) {
+		copies[i] = *entities[ vals[i] ];
+	}
+	for (u32 i=0; i<count; ++i) {
+		*slots[i] = copies[i];
+		entities[i] = slots[i];
+		if (remap) (*remap)[ vals[i] ] = i;
+	}
+}